@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "type.h"
+
+//a multi pin element that is evaluated as a whole instead of being built from gates
+//the pins are contiguous, first the inputs (BLOCK_IN) then the outputs (BLOCK_OUT)
+//an input change schedules one evaluation on the first output pin after the delay of the block type,
+//the evaluation reads all inputs and writes all outputs at once
+//
+//RAM: word addressed memory, the words are stored in SimulationState::blockMemory
+//  inputs:  address (addressSize), data (dataSize), read, write, clock
+//  outputs: data (dataSize), the addressed word while clock and read are high, otherwise low
+//  the addressed word is written while clock and write are high, addresses from wordCount on are not backed
+//
+//word level blocks, dataSize is the word width
+//WORD_ADD:     inputs a, b, carry in, outputs sum, carry out
+//WORD_LATCH:   inputs data, enable, outputs the latched word, follows data while enable is high
+//WORD_DECODER: inputs select (addressSize), outputs 2^addressSize lines, only the selected one is high
+//WORD_AND:     inputs data, enable, outputs data while enable is high, otherwise low
+class Block {
+public:
+	GateType type = GateType::RAM;
+	Index firstPin = 0;
+	Index inputCount = 0;
+	Index outputCount = 0;
+	int32_t addressSize = 0;
+	int32_t dataSize = 0;
+	int64_t wordCount = 0;
+	//byte range in SimulationState::blockMemory
+	int64_t memoryOffset = 0;
+	int64_t memorySize = 0;
+
+	Index getOutputPin() const {
+		return firstPin + inputCount;
+	}
+
+	Index getEndPin() const {
+		return firstPin + inputCount + outputCount;
+	}
+
+	int getWordBytes() const {
+		return (dataSize + 7) / 8;
+	}
+};
+
+//evaluates a block on the current pin states, calls setOutput(pin, value) for every output pin
+template<typename Function>
+void evaluateBlock(const Block& block, const uint8_t* pinStates, uint8_t* memory, Function setOutput) {
+	const uint8_t* inputs = pinStates + block.firstPin;
+	Index output = block.getOutputPin();
+
+	switch (block.type) {
+	case GateType::RAM: {
+		int64_t address = 0;
+		for (int i = 0; i < block.addressSize; i++) {
+			address |= (int64_t)inputs[i] << i;
+		}
+		const uint8_t* data = inputs + block.addressSize;
+		const uint8_t* control = data + block.dataSize;
+		bool read = control[0];
+		bool write = control[1];
+		bool clock = control[2];
+
+		uint8_t* word = address < block.wordCount ? memory + address * block.getWordBytes() : nullptr;
+		if (word && clock && write) {
+			for (int i = 0; i < block.dataSize; i++) {
+				if (data[i]) {
+					word[i / 8] |= 1 << (i % 8);
+				}
+				else {
+					word[i / 8] &= ~(1 << (i % 8));
+				}
+			}
+		}
+		bool enabled = word && clock && read;
+		for (int i = 0; i < block.dataSize; i++) {
+			setOutput(output + i, enabled ? (word[i / 8] >> (i % 8)) & 1 : 0);
+		}
+		break;
+	}
+	case GateType::WORD_ADD: {
+		const uint8_t* a = inputs;
+		const uint8_t* b = inputs + block.dataSize;
+		uint8_t carry = inputs[block.dataSize * 2];
+		for (int i = 0; i < block.dataSize; i++) {
+			setOutput(output + i, a[i] ^ b[i] ^ carry);
+			carry = (a[i] & b[i]) | (carry & (a[i] ^ b[i]));
+		}
+		setOutput(output + block.dataSize, carry);
+		break;
+	}
+	case GateType::WORD_LATCH: {
+		if (inputs[block.dataSize]) {
+			for (int i = 0; i < block.dataSize; i++) {
+				setOutput(output + i, inputs[i]);
+			}
+		}
+		break;
+	}
+	case GateType::WORD_DECODER: {
+		Index select = 0;
+		for (int i = 0; i < block.addressSize; i++) {
+			select |= (Index)inputs[i] << i;
+		}
+		for (Index i = 0; i < block.outputCount; i++) {
+			setOutput(output + i, i == select);
+		}
+		break;
+	}
+	case GateType::WORD_AND: {
+		uint8_t enable = inputs[block.dataSize];
+		for (int i = 0; i < block.dataSize; i++) {
+			setOutput(output + i, inputs[i] & enable);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
@@ -70,6 +70,12 @@ Bus Bus::split(int index, int parts) {
 	return result;
 }
 
+Bus Bus::rebind(Circuit* circuit) {
+	Bus result = *this;
+	result.circuit = circuit;
+	return result;
+}
+
 void Bus::setValue(uint64_t value) {
 	for (int i = 0; i < pins.size(); i++) {
 		if (value & (1ull << i)) {
@@ -94,6 +100,25 @@ uint64_t Bus::getValue() {
 	return value;
 }
 
+bool Bus::setValue(uint64_t value, int lane) {
+	for (int i = 0; i < pins.size(); i++) {
+		if (!getPin(i).setValue(value & (1ull << i), lane)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t Bus::getValue(int lane) {
+	uint64_t value = 0;
+	for (int i = 0; i < pins.size(); i++) {
+		if (getPin(i).getValue(lane)) {
+			value |= (1ull << i);
+		}
+	}
+	return value;
+}
+
 std::string Bus::getStrValue() {
 	std::string value;
 	for (int i = pins.size() - 1; i >= 0; i--) {
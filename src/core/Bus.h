@@ -24,8 +24,13 @@ public:
 	Bus AND(Pin rhs);
 	Bus connect(Bus rhs);
 	Bus split(int index, int parts);
+	//the same bus in another circuit sharing the netlist
+	Bus rebind(Circuit* circuit);
 
 	void setValue(uint64_t value);
 	uint64_t getValue();
+	//one lane of the bus, a lane that is not simulated reads as 0, setting it returns false and changes nothing (see Pin)
+	bool setValue(uint64_t value, int lane);
+	uint64_t getValue(int lane);
 	std::string getStrValue();
 };
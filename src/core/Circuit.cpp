@@ -3,9 +3,12 @@
 //
 
 #include "Circuit.h"
+#include "util/Clock.h"
 #include <cassert>
+#include <algorithm>
 
 Index Circuit::addGate(GateType type) {
+	editNetlist();
 	switch (type)
 	{
 	case GateType::CONNECTOR:
@@ -17,468 +20,1079 @@ Index Circuit::addGate(GateType type) {
 	case GateType::BUF:
 		addPin(PinType::BUF_IN);
 		addPin(PinType::BUF_OUT);
-		gateCount++;
+		netlist->gateCount++;
 		break;
 	case GateType::NOT:
 		addPin(PinType::NOT_IN);
 		addPin(PinType::NOT_OUT);
-		gateCount++;
+		netlist->gateCount++;
 		break;
 	case GateType::OR:
 		addPin(PinType::OR_A);
 		addPin(PinType::OR_B);
 		addPin(PinType::OR_OUT);
-		gateCount++;
+		netlist->gateCount++;
 		break;
 	case GateType::AND:
 		addPin(PinType::AND_A);
 		addPin(PinType::AND_B);
 		addPin(PinType::AND_OUT);
-		gateCount++;
+		netlist->gateCount++;
 		break;
 	case GateType::NOR:
 		addPin(PinType::NOR_A);
 		addPin(PinType::NOR_B);
 		addPin(PinType::NOR_OUT);
-		gateCount++;
+		netlist->gateCount++;
 		break;
 	case GateType::NAND:
 		addPin(PinType::NAND_A);
 		addPin(PinType::NAND_B);
 		addPin(PinType::NAND_OUT);
-		gateCount++;
+		netlist->gateCount++;
 		break;
 	case GateType::XOR:
 		addPin(PinType::XOR_A);
 		addPin(PinType::XOR_B);
 		addPin(PinType::XOR_OUT);
-		gateCount++;
+		netlist->gateCount++;
 		break;
 	case GateType::D_LATCH:
 		addPin(PinType::D_LATCH_DATA);
 		addPin(PinType::D_LATCH_ENABLE);
 		addPin(PinType::D_LATCH_OUT);
-		gateCount++;
+		netlist->gateCount++;
 		break;
 	default:
 		break;
 	}
-	return pins.size() - 1;
+	return netlist->pins.size() - 1;
+}
+
+Index Circuit::addRam(int addressSize, int dataSize, int64_t wordCount) {
+	Block block;
+	block.type = GateType::RAM;
+	block.inputCount = addressSize + dataSize + 3;
+	block.outputCount = dataSize;
+	block.addressSize = addressSize;
+	block.dataSize = dataSize;
+	block.wordCount = wordCount;
+	block.memorySize = wordCount * block.getWordBytes();
+	return addBlock(block);
+}
+
+Index Circuit::addBlock(GateType type, int size) {
+	Block block;
+	block.type = type;
+	block.dataSize = size;
+	switch (type) {
+	case GateType::WORD_ADD:
+		block.inputCount = size * 2 + 1;
+		block.outputCount = size + 1;
+		break;
+	case GateType::WORD_LATCH:
+	case GateType::WORD_AND:
+		block.inputCount = size + 1;
+		block.outputCount = size;
+		break;
+	case GateType::WORD_DECODER:
+		block.addressSize = size;
+		block.dataSize = 0;
+		block.inputCount = size;
+		block.outputCount = (Index)1 << size;
+		break;
+	default:
+		return -1;
+	}
+	return addBlock(block);
+}
+
+Index Circuit::addBlock(Block block) {
+	block.memoryOffset = editNetlist().getBlockMemorySize();
+	block.firstPin = netlist->pins.size();
+
+	for (Index i = 0; i < block.inputCount; i++) {
+		addPin(PinType::BLOCK_IN);
+	}
+	for (Index i = 0; i < block.outputCount; i++) {
+		addPin(PinType::BLOCK_OUT);
+	}
+	netlist->blocks.push_back(block);
+	netlist->gateCount++;
+	state.blockMemory.resize(netlist->getBlockMemorySize(), 0);
+	return block.firstPin;
+}
+
+Index Circuit::addModule(const std::string& name, const Circuit& definition, const std::map<std::string, Bus>& ports) {
+	std::map<std::string, std::vector<Index>> portPins;
+	for (auto& port : ports) {
+		portPins[port.first] = port.second.pins;
+	}
+	return editNetlist().addModule(name, *definition.netlist, portPins);
+}
+
+SubCircuit Circuit::addInstance(Index module) {
+	Netlist& netlist = editNetlist();
+	const Module& definition = netlist.modules[module];
+	Index firstPin = netlist.pins.size();
+	int64_t memoryOffset = netlist.getBlockMemorySize();
+
+	netlist.pins.insert(netlist.pins.end(), definition.pins.begin(), definition.pins.end());
+	netlist.prepared = false;
+	state.pinStates.resize(netlist.pins.size(), 0);
+	for (Index pin : definition.constantPins) {
+		netlist.constantPins.push_back(firstPin + pin);
+	}
+	for (Block block : definition.blocks) {
+		block.firstPin += firstPin;
+		block.memoryOffset += memoryOffset;
+		netlist.blocks.push_back(block);
+	}
+	state.blockMemory.resize(netlist.getBlockMemorySize(), 0);
+	netlist.instances.push_back({ module, firstPin });
+	netlist.gateCount += definition.gateCount;
+
+	SubCircuit instance;
+	instance.circuit = this;
+	instance.module = module;
+	instance.firstPin = firstPin;
+	instance.name = definition.name;
+	for (auto& port : definition.ports) {
+		Bus bus;
+		bus.circuit = this;
+		for (Index pin : port.second) {
+			bus.addPin(Pin(this, firstPin + pin));
+		}
+		instance.buses[port.first] = bus;
+		if (bus.size() == 1) {
+			instance.pins[port.first] = bus.getPin(0);
+		}
+	}
+	return instance;
+}
+
+std::vector<ModuleStats> Circuit::getModuleStats() {
+	return netlist->getModuleStats();
 }
 
 void Circuit::addLine(Index pinA, Index pinB) {
-	lines.push_back({ pinA, pinB });
+	editNetlist().lines.push_back({ pinA, pinB });
 }
 
 Index Circuit::addPin(PinType type) {
-	pins.push_back(type);
-	inboundPin.push_back(-1);
-	outboundPin.push_back(-1);
-	pinStates.push_back(false);
-	Index index = pins.size() - 1;
+	netlist->pins.push_back(type);
+	netlist->prepared = false;
+	state.pinStates.push_back(false);
+	Index index = netlist->pins.size() - 1;
 	return index;
 }
 
+Netlist& Circuit::editNetlist() {
+	if (netlist.use_count() > 1) {
+		netlist = std::make_shared<Netlist>(*netlist);
+	}
+	return *netlist;
+}
+
 int Circuit::getGateCount() {
-	return gateCount;
+	return netlist->gateCount;
 }
 
 int Circuit::getPinCount() {
-	return pins.size();
+	return netlist->pins.size();
 }
 
 int Circuit::getLineCount() {
-	return lines.size();
+	return netlist->getLineCount();
 }
 
 int64_t Circuit::getSimulationTime() {
-	return simulationTime;
+	return state.simulationTime;
 }
 
 void Circuit::setGateDelay(GateType type, int delay) {
-	if (gateDelays.size() <= (int)type) {
-		gateDelays.resize((int)type + 1, 1);
-	}
-	gateDelays[(int)type] = delay;
+	editNetlist().setGateDelay(type, delay);
 }
 
 void Circuit::setSimulationMode(bool sortQueue) {
-	queue.sortQueue = sortQueue;
+	state.queue.sortQueue = sortQueue;
 }
 
-void Circuit::prepare() {
-	gateDelays.resize((int)GateType::GATE_TYPE_COUNT, 1);
+void Circuit::setSimulationEngine(SimulationEngine engine) {
+	if (this->engine == engine) {
+		return;
+	}
+	SimulationEngine previous = this->engine;
+	this->engine = engine;
+	if (netlist->prepared) {
+		if (previous == SimulationEngine::LEVELIZED) {
+			levelized.writePinStates();
+			updateGroupHighCounts();
+		}
+		initEngine();
+	}
+}
+
+int Circuit::setLaneCount(int count) {
+	if (count < 1 || count > 64) {
+		return getLaneCount();
+	}
+	laneCount = count;
+	levelized.laneMask = count == 64 ? ~0ull : (1ull << count) - 1;
+	//lanes start with the state of the first lane
+	if (netlist->prepared && engine == SimulationEngine::LEVELIZED) {
+		levelized.writePinStates();
+		levelized.build(this);
+	}
+	return getLaneCount();
+}
 
-	pinStates.clear();
-	pinStates.resize(pins.size(), 0);
+int Circuit::getLaneCount() {
+	//before prepare the engine is not switched yet for blocks and clocks (see initEngine)
+	bool lanes = engine == SimulationEngine::LEVELIZED && netlist->blocks.empty() && clocks.empty();
+	return lanes ? laneCount : 1;
+}
 
-	initPinConnections();
+void Circuit::setThreadCount(int count) {
+	threadCount = std::max(count, 1);
+	if (netlist->prepared && engine == SimulationEngine::PARALLEL) {
+		parallel.build(this, threadCount);
+	}
+}
 
-	for (Index i = 0; i < pins.size(); i++) {
-		addPinToQueue(i);
+int Circuit::getThreadCount() {
+	return engine == SimulationEngine::PARALLEL ? threadCount : 1;
+}
+
+bool Circuit::getPinValue(Index pin) {
+	if (netlist->prepared && engine == SimulationEngine::LEVELIZED) {
+		return levelized.getPin(pin) & 1;
 	}
-	changedPins.clear();
-	processQueue();
-	simulationTime = 0;
+	return state.pinStates[pin] != 0;
 }
 
-int Circuit::simulate(int timeUnits) {
-	for (auto& pin : changedPins) {
-		addPinToQueue(pin, 0, true);
+void Circuit::setPinValue(Index pin, bool value) {
+	if (netlist->prepared && engine == SimulationEngine::LEVELIZED) {
+		levelized.setPin(pin, value ? ~0ull : 0);
+		state.pinStates[pin] = value;
+	}
+	else if (state.pinStates[pin] != value) {
+		setPinState(pin, value);
+		state.changedPins.push_back(pin);
 	}
-	changedPins.clear();
-	return processQueue(timeUnits);
 }
 
-void Circuit::addPinConnection(Index pinA, Index pinB) {
-	PinBaseType a = getPinBaseType(pins[pinA]);
-	PinBaseType b = getPinBaseType(pins[pinB]);
+uint64_t Circuit::getPinLanes(Index pin) {
+	if (netlist->prepared && engine == SimulationEngine::LEVELIZED) {
+		return levelized.getPin(pin);
+	}
+	return state.pinStates[pin] != 0;
+}
 
-	if (b == PinBaseType::INPUT || b == PinBaseType::CONNECTOR) {
-		if (a == PinBaseType::OUTPUT || a == PinBaseType::CONNECTOR) {
+bool Circuit::setPinLanes(Index pin, uint64_t lanes, uint64_t mask) {
+	int count = getLaneCount();
+	if ((mask & (count == 64 ? ~0ull : (1ull << count) - 1)) == 0) {
+		return false;
+	}
+	if (netlist->prepared && engine == SimulationEngine::LEVELIZED) {
+		levelized.setPin(pin, lanes, mask);
+		if (mask & 1) {
+			state.pinStates[pin] = lanes & 1;
+		}
+	}
+	else if (mask & 1) {
+		setPinValue(pin, lanes & 1);
+	}
+	return true;
+}
 
-			if (inboundPin[pinB] == -1) {
-				inboundPin[pinB] = pinA;
-			}
-			else if (inboundPin[pinB] == -2) {
-				inboundPins[pinB].insert(pinA);
-			}
-			else {
-				if (inboundPin[pinB] != pinA) {
-					inboundPins[pinB].insert(inboundPin[pinB]);
-					inboundPins[pinB].insert(pinA);
-					inboundPin[pinB] = -2;
-				}
-			}
+uint8_t* Circuit::getBlockMemory(Index pin) {
+	return state.blockMemory.data() + netlist->getBlock(pin).memoryOffset;
+}
 
-			if (outboundPin[pinA] == -1) {
-				outboundPin[pinA] = pinB;
-			}
-			else if (outboundPin[pinA] == -2) {
-				outboundPins[pinA].insert(pinB);
-			}
-			else {
-				if (outboundPin[pinA] != pinB) {
-					outboundPins[pinA].insert(outboundPin[pinA]);
-					outboundPins[pinA].insert(pinB);
-					outboundPin[pinA] = -2;
-				}
-			}
+void Circuit::setEventDeduplication(bool enabled) {
+	state.queue.useUpdateSet = enabled;
+	std::fill(state.queue.pendingPins.begin(), state.queue.pendingPins.end(), 0);
+}
+
+int64_t Circuit::getQueuedEventCount() {
+	return state.queue.addedCount;
+}
+
+int64_t Circuit::getSkippedEventCount() {
+	return state.queue.skippedCount;
+}
+
+const SimulationStats& Circuit::getStats() {
+	stats.queuedEvents = state.queue.addedCount - statsAddedCount;
+	stats.deduplicatedEvents = state.queue.skippedCount - statsSkippedCount;
+	return stats;
+}
+
+void Circuit::resetStats() {
+	stats = SimulationStats();
+	std::fill(scopeEvents.begin(), scopeEvents.end(), 0);
+	std::fill(scopeGlitches.begin(), scopeGlitches.end(), 0);
+	statsAddedCount = state.queue.addedCount;
+	statsSkippedCount = state.queue.skippedCount;
+}
+
+void Circuit::dumpStats(FILE* file) {
+	fprintf(file, "%s\n", getStats().toJson().c_str());
+}
+
+void Circuit::pushScope(const std::string& name) {
+	Netlist& netlist = editNetlist();
+	if (netlist.scopes.empty()) {
+		netlist.scopes.push_back("");
+	}
+	Index parent = scopeStack.empty() ? 0 : scopeStack.back();
+	std::string fullName = parent == 0 ? name : netlist.scopes[parent] + "/" + name;
+	Index scope = std::find(netlist.scopes.begin(), netlist.scopes.end(), fullName) - netlist.scopes.begin();
+	if (scope == netlist.scopes.size()) {
+		netlist.scopes.push_back(fullName);
+	}
+	scopeStack.push_back(scope);
+	beginScope(scope);
+}
+
+void Circuit::popScope() {
+	if (scopeStack.empty()) {
+		return;
+	}
+	scopeStack.pop_back();
+	beginScope(scopeStack.empty() ? 0 : scopeStack.back());
+}
+
+void Circuit::beginScope(Index scope) {
+	Netlist& netlist = editNetlist();
+	Index firstPin = netlist.pins.size();
+	if (!netlist.scopeRanges.empty() && netlist.scopeRanges.back().first == firstPin) {
+		netlist.scopeRanges.back().second = scope;
+	}
+	else {
+		netlist.scopeRanges.push_back({ firstPin, scope });
+	}
+}
 
+std::vector<ScopeActivity> Circuit::getScopeActivity() {
+	std::vector<ScopeActivity> activity(netlist->scopes.size());
+	for (Index scope = 0; scope < activity.size(); scope++) {
+		activity[scope].name = scope == 0 ? "(top)" : netlist->scopes[scope];
+	}
+	Index scope = 0;
+	Index range = 0;
+	Index block = 0;
+	for (Index pin = 0; pin < netlist->pins.size() && !activity.empty(); pin++) {
+		while (range < netlist->scopeRanges.size() && netlist->scopeRanges[range].first <= pin) {
+			scope = netlist->scopeRanges[range++].second;
+		}
+		activity[scope].gates += getPinBaseType(netlist->pins[pin]) == PinBaseType::OUTPUT;
+		//a block counts once, in the scope of its first pin
+		if (block < netlist->blocks.size() && netlist->blocks[block].firstPin == pin) {
+			activity[scope].gates++;
+			block++;
 		}
 	}
+
+	int64_t totalEvents = 0;
+	for (Index scope = 0; scope < scopeEvents.size(); scope++) {
+		activity[scope].events = scopeEvents[scope];
+		activity[scope].glitches = scopeGlitches[scope];
+		totalEvents += scopeEvents[scope];
+	}
+	for (auto& entry : activity) {
+		entry.share = totalEvents > 0 ? (double)entry.events / totalEvents : 0;
+	}
+	std::stable_sort(activity.begin(), activity.end(), [](const ScopeActivity& a, const ScopeActivity& b) {
+		return a.events > b.events;
+	});
+	return activity;
+}
+
+void Circuit::dumpScopeActivity(FILE* file) {
+	auto activity = getScopeActivity();
+	fprintf(file, "%-32s %8s %12s %7s %10s\n", "scope", "gates", "events", "share", "glitches");
+	for (auto& entry : activity) {
+		fprintf(file, "%-32s %8i %12lli %6.1f%% %10lli\n", entry.name.c_str(), entry.gates, (long long)entry.events, entry.share * 100, (long long)entry.glitches);
+	}
+}
+
+void Circuit::initScopes() {
+	scopeByPin.clear();
+	scopeEvents.clear();
+	scopeGlitches.clear();
+	pinPhases.clear();
+	if (netlist->scopes.empty()) {
+		return;
+	}
+	scopeByPin.assign(netlist->pins.size(), 0);
+	auto& ranges = netlist->scopeRanges;
+	for (Index range = 0; range < ranges.size(); range++) {
+		Index end = range + 1 < ranges.size() ? ranges[range + 1].first : netlist->pins.size();
+		std::fill(scopeByPin.begin() + ranges[range].first, scopeByPin.begin() + end, ranges[range].second);
+	}
+	scopeEvents.assign(netlist->scopes.size(), 0);
+	scopeGlitches.assign(netlist->scopes.size(), 0);
+	pinPhases.assign(netlist->pins.size(), 0);
+}
+
+void Circuit::recordScopeChange(Index pin) {
+	uint64_t& pinPhase = pinPhases[pin];
+	if ((pinPhase >> 1) != phase) {
+		pinPhase = (phase << 1) | 1;
+	}
+	else {
+		//every second change within a call restores the value the pin had before
+		pinPhase ^= 1;
+		if (!(pinPhase & 1)) {
+			scopeGlitches[scopeByPin[pin]]++;
+		}
+	}
+}
+
+void Circuit::optimize() {
+	optimizationStats = editNetlist().optimize();
+}
+
+const OptimizationStats& Circuit::getOptimizationStats() {
+	return optimizationStats;
+}
+
+void Circuit::prepare() {
+	Netlist& netlist = editNetlist();
+	//the groups change, recording starts again in initEngine
+	watchByGroup.clear();
+	sampledWatches.clear();
+	scopeByPin.clear();
+	netlist.gateDelays.resize((int)GateType::GATE_TYPE_COUNT, 1);
+
+	Clock clock;
+	netlist.initGroups();
+	prepareTimings.groups = clock.round();
+	netlist.initPinConnections();
+	netlist.initPinDescriptors();
+	prepareTimings.connections = clock.round();
+
+	//settle the initial state from all pins low
+	netlist.initialPinStates.clear();
+	netlist.initialPinStates.resize(netlist.pins.size(), 0);
+	netlist.initialGroupHighCount.clear();
+	netlist.initialGroupHighCount.resize(netlist.groupCount, 0);
+	state.reset(netlist);
+	for (Index i = 0; i < netlist.pins.size(); i++) {
+		addPinToQueue(i);
+	}
+	processQueue();
+	state.simulationTime = 0;
+	netlist.initialPinStates = state.pinStates;
+	netlist.initialGroupHighCount = state.groupHighCount;
+	netlist.prepared = true;
+	initEngine();
+	resetStats();
+	prepareTimings.initialState = clock.round();
+	prepareTimings.total = prepareTimings.groups + prepareTimings.connections + prepareTimings.initialState;
 }
 
-void Circuit::initPinConnections() {
-	inboundPin.clear();
-	inboundPins.clear();
-	outboundPin.clear();
-	outboundPins.clear();
-	inboundPin.resize(pins.size(), -1);
-	outboundPin.resize(pins.size(), -1);
+const PrepareTimings& Circuit::getPrepareTimings() {
+	return prepareTimings;
+}
 
-	groups.clear();
-	groupByPin.clear();
-	groupUpToDate.clear();
-	groupValues.clear();
-	groupByPin.resize(pins.size(), -1);
+std::shared_ptr<Netlist> Circuit::getNetlist() {
+	return netlist;
+}
 
-	for (auto& line : lines) {
-		Index a = line.first;
-		Index b = line.second;
-		Index ag = groupByPin[a];
-		Index bg = groupByPin[b];
+void Circuit::setNetlist(std::shared_ptr<Netlist> netlist) {
+	this->netlist = netlist;
+	state.reset(*netlist);
+	if (netlist->prepared) {
+		initEngine();
+	}
+}
 
-		if (ag == -1 && bg == -1) {
-			groups.emplace_back();
-			auto g = groups.size() - 1;
-			groups[g].insert(a);
-			groups[g].insert(b);
-			groupByPin[a] = g;
-			groupByPin[b] = g;
+Snapshot Circuit::snapshot() {
+	Snapshot result;
+	snapshot(result);
+	return result;
+}
+
+void Circuit::snapshot(Snapshot& snapshot) {
+	bool levelizedActive = netlist->prepared && engine == SimulationEngine::LEVELIZED;
+	if (levelizedActive) {
+		levelized.writePinStates();
+		updateGroupHighCounts();
+	}
+
+	snapshot.pinStates = state.pinStates;
+	snapshot.changedPins = state.changedPins;
+	snapshot.groupHighCount = state.groupHighCount;
+	snapshot.groupForced = state.groupForced;
+	snapshot.simulationTime = state.simulationTime;
+	snapshot.addedCount = state.queue.addedCount;
+	snapshot.skippedCount = state.queue.skippedCount;
+	snapshot.blockMemory = state.blockMemory;
+	snapshot.events.clear();
+	state.queue.getEvents(snapshot.events);
+	if (engine == SimulationEngine::PARALLEL) {
+		for (auto& partition : parallel.partitions) {
+			partition.queue.getEvents(snapshot.events);
 		}
-		else if (ag == -1) {
-			groups[bg].insert(a);
-			groupByPin[a] = bg;
+		//partition queues are each in order, merge them by time
+		std::stable_sort(snapshot.events.begin(), snapshot.events.end(), [](auto& a, auto& b) {
+			return a.time < b.time;
+		});
+	}
+
+	if (levelizedActive) {
+		levelized.snapshot(snapshot);
+	}
+	else {
+		snapshot.nodeValues.clear();
+		snapshot.nodeDriverValues.clear();
+		snapshot.nodeForcedValues.clear();
+		snapshot.nodeDirty.clear();
+	}
+}
+
+bool Circuit::restore(const Snapshot& snapshot) {
+	if (snapshot.pinStates.size() != netlist->pins.size() || snapshot.groupHighCount.size() != netlist->groupCount) {
+		return false;
+	}
+	if (snapshot.blockMemory.size() != netlist->getBlockMemorySize()) {
+		return false;
+	}
+	state.pinStates = snapshot.pinStates;
+	state.changedPins = snapshot.changedPins;
+	state.groupHighCount = snapshot.groupHighCount;
+	state.groupForced = snapshot.groupForced;
+	state.simulationTime = snapshot.simulationTime;
+	state.blockMemory = snapshot.blockMemory;
+
+	state.queue.clear();
+	if (netlist->prepared && engine == SimulationEngine::PARALLEL) {
+		for (auto& partition : parallel.partitions) {
+			partition.queue.clear();
 		}
-		else if (bg == -1) {
-			groups[ag].insert(b);
-			groupByPin[b] = ag;
+		for (auto& event : snapshot.events) {
+			parallel.partitions[parallel.partitionByPin[event.pin]].queue.add(event.pin, event.time, event.external);
 		}
-		else {
-			for (auto i : groups[bg]) {
-				groups[ag].insert(i);
-				groupByPin[i] = ag;
-			}
-			groups[bg].clear();
+		for (auto& partition : parallel.partitions) {
+			partition.queue.addedCount = 0;
+			partition.queue.skippedCount = 0;
 		}
 	}
+	else {
+		for (auto& event : snapshot.events) {
+			state.queue.add(event.pin, event.time, event.external);
+		}
+	}
+	state.queue.addedCount = snapshot.addedCount;
+	state.queue.skippedCount = snapshot.skippedCount;
 
-	for (auto& group : groups) {
-		for (auto& a : group) {
-			for (auto& b : group) {
-				if (a != b) {
-					addPinConnection(a, b);
-				}
-			}
+	if (netlist->prepared && engine == SimulationEngine::LEVELIZED) {
+		if (!levelized.restore(snapshot)) {
+			levelized.build(this);
 		}
 	}
+	return true;
+}
 
-	groupUpToDate.resize(groups.size(), false);
-	groupValues.resize(groups.size(), false);
+bool Circuit::saveNetlist(const std::string& file) {
+	return netlist->save(file);
+}
 
-	for (auto& group : groups) {
-		auto it = group.begin();
-		while (it != group.end()) {
-			auto current = it++;
-			auto pin = *current;
-			auto baseType = getPinBaseType(pins[pin]);
-			if (baseType == PinBaseType::INPUT) {
-				group.erase(current);
-			}
+bool Circuit::loadNetlist(const std::string& file, bool validateHash) {
+	auto loaded = std::make_shared<Netlist>();
+	if (!loaded->load(file, validateHash)) {
+		return false;
+	}
+	setNetlist(loaded);
+	return true;
+}
+
+void Circuit::initEngine() {
+	if (engine == SimulationEngine::LEVELIZED && !netlist->blocks.empty()) {
+		engine = SimulationEngine::EVENT;
+	}
+	if (!clocks.empty()) {
+		engine = SimulationEngine::EVENT;
+	}
+	if (engine == SimulationEngine::LEVELIZED) {
+		levelized.build(this);
+	}
+	else if (engine == SimulationEngine::PARALLEL) {
+		parallel.build(this, threadCount);
+	}
+	initWatches();
+	initScopes();
+}
+
+int Circuit::simulate(int timeUnits) {
+	return run(timeUnits, true);
+}
+
+Index Circuit::addClock(Pin pin, int period, int highTime, int phase) {
+	if (period < 2 || highTime < 1 || highTime >= period || phase < 0) {
+		return -1;
+	}
+	setSimulationEngine(SimulationEngine::EVENT);
+	setPinValue(pin.index, false);
+
+	ClockSource clock;
+	clock.pin = pin.index;
+	clock.period = period;
+	clock.highTime = highTime;
+	clock.nextEdge = state.simulationTime + phase;
+	clocks.push_back(clock);
+	nextClockEdge = std::min(nextClockEdge, clock.nextEdge);
+	return clocks.size() - 1;
+}
+
+void Circuit::removeClocks() {
+	clocks.clear();
+	nextClockEdge = INT64_MAX;
+}
+
+void Circuit::addStopCondition(Bus bus, uint64_t value) {
+	stopConditions.push_back({ bus, value });
+}
+
+void Circuit::removeStopConditions() {
+	stopConditions.clear();
+}
+
+bool Circuit::isStopped() {
+	return stopped;
+}
+
+int Circuit::settle(int maxTimeUnits) {
+	int timeNeeded = run(maxTimeUnits, false);
+	if (!isSettled()) {
+		return -1;
+	}
+	return timeNeeded;
+}
+
+bool Circuit::isSettled() {
+	if (engine == SimulationEngine::LEVELIZED) {
+		return !levelized.unstable;
+	}
+	else if (engine == SimulationEngine::PARALLEL && parallel.getLookahead() >= 1) {
+		return state.changedPins.empty() && !parallel.hasEvents();
+	}
+	else {
+		return state.changedPins.empty() && state.queue.empty();
+	}
+}
+
+int Circuit::run(int timeUnits, bool fillTime) {
+	Clock clock;
+	int64_t startSimulationTime = state.simulationTime;
+	int timeNeeded = 0;
+	phase++;
+	if (engine == SimulationEngine::LEVELIZED) {
+		//zero delay, the time limit bounds the sweeps instead
+		if (timeUnits != -1 && fillTime) {
+			state.simulationTime += timeUnits;
 		}
+		int sweepLimit = timeUnits == -1 ? levelized.maxSweeps : std::min(timeUnits, levelized.maxSweeps);
+		int64_t evaluationCount = levelized.evaluationCount;
+		stats.sweeps += levelized.settle(sweepLimit);
+		stats.evaluations += levelized.evaluationCount - evaluationCount;
 	}
+	//without a gate delay there is no lookahead between partitions, zero delay gates run sequentially
+	else if (engine == SimulationEngine::PARALLEL && parallel.getLookahead() >= 1) {
+		timeNeeded = parallel.simulate(timeUnits, fillTime);
+	}
+	else {
+		for (auto& pin : state.changedPins) {
+			addPinToQueue(pin, 0, true);
+		}
+		state.changedPins.clear();
+		timeNeeded = processQueue(timeUnits, fillTime);
+	}
+
+	if (!sampledWatches.empty()) {
+		sampleWatches();
+	}
+	stats.simulateCalls++;
+	stats.simulatedTime += state.simulationTime - startSimulationTime;
+	stats.time += clock.elapsed();
+	return timeNeeded;
 }
 
-bool Circuit::getInboundSignal(Index pin) {
-	Index source = inboundPin[pin];
+bool Circuit::getInboundSignal(Index pin, SimulationStats& stats) {
+	Index source = netlist->inboundPin[pin];
 	if (source == -1) {
-		return pinStates[pin];
+		return state.pinStates[pin];
 	}
 	else if (source == -2) {
-		auto groupIndex = groupByPin[pin];
-		if (groupUpToDate[groupIndex]) {
-			return groupValues[groupIndex];
-		}
+		stats.groupReads++;
+		return getGroupValue(netlist->groupByPin[pin]);
+	}
+	else {
+		return state.pinStates[source];
+	}
+}
 
-		auto &group = groups[groupIndex];
+bool Circuit::getGroupValue(Index group) {
+	return state.groupHighCount[group] > 0 || state.groupForced[group];
+}
 
-		bool value = false;
-		for (auto& i : group) {
-			if (i != pin) {
-				value |= pinStates[i];
-				if (value) {
-					break;
-				}
-			}
+void Circuit::setPinState(Index pin, bool value) {
+	if (state.pinStates[pin] != value) {
+		state.pinStates[pin] = value;
+		updateGroupHighCount(pin, value);
+	}
+}
+
+void Circuit::updateGroupHighCount(Index pin, bool value) {
+	Index group = netlist->groupByDriver[pin];
+	if (group != -1) {
+		state.groupHighCount[group] += value ? 1 : -1;
+		state.groupForced[group] = false;
+		if (!watchByGroup.empty()) {
+			recordGroup(group);
 		}
+	}
+}
 
-		groupUpToDate[groupIndex] = true;
-		groupValues[groupIndex] = value;
-		return value;
+void Circuit::recordGroup(Index group) {
+	uint8_t value = getGroupValue(group);
+	for (Index index = watchByGroup[group]; index != -1; index = watches[index].next) {
+		recordWatch(watches[index], value);
 	}
+}
+
+void Circuit::recordWatch(Watch& watch, uint8_t value) {
+	if (watch.value == value) {
+		return;
+	}
+	watch.value = value;
+	if (watch.target >= 0) {
+		waveform->capture(state.simulationTime, watch.target, value);
+	}
+#if ICSIM_PROBES
 	else {
-		return pinStates[source];
+		probes[-watch.target - 1].record(state.simulationTime, watch.pin, value);
+	}
+#endif
+}
+
+void Circuit::sampleWatches() {
+	for (Index index : sampledWatches) {
+		recordWatch(watches[index], getPinValue(watches[index].pin));
+	}
+}
+
+bool Circuit::setWaveformWriter(WaveformWriter* writer) {
+	if (writer && !writer->isOpen()) {
+		return false;
+	}
+	waveform = writer;
+	initWatches();
+	return true;
+}
+
+Index Circuit::addProbe(const std::string& name, Bus bus, int depth) {
+	Probe probe;
+	probe.name = name;
+	probe.pins = bus.pins;
+	probe.ring.resize(std::max(depth, 1));
+	probes.push_back(probe);
+	initWatches();
+	return probes.size() - 1;
+}
+
+Index Circuit::addProbe(const std::string& name, Pin pin, int depth) {
+	Bus bus;
+	bus.circuit = this;
+	bus.addPin(pin);
+	return addProbe(name, bus, depth);
+}
+
+Probe& Circuit::getProbe(Index probe) {
+	return probes[probe];
+}
+
+void Circuit::removeProbes() {
+	probes.clear();
+	initWatches();
+}
+
+void Circuit::dumpProbes(FILE* file) {
+	for (auto& probe : probes) {
+		probe.dump(file);
+	}
+}
+
+void Circuit::addWatch(Index pin, Index target, bool events) {
+	Watch watch;
+	watch.pin = pin;
+	watch.target = target;
+	Index group = netlist->groupByPin[pin];
+	if (events && group != -1) {
+		watch.next = watchByGroup[group];
+		watchByGroup[group] = watches.size();
+		//waveforms start with the current values, probes only keep transitions
+		watch.value = target >= 0 ? 2 : getGroupValue(group);
+	}
+	else {
+		sampledWatches.push_back(watches.size());
+		watch.value = target >= 0 ? 2 : getPinValue(pin);
+	}
+	watches.push_back(watch);
+}
+
+void Circuit::initWatches() {
+	watches.clear();
+	watchByGroup.clear();
+	sampledWatches.clear();
+	if (!netlist->prepared) {
+		return;
+	}
+
+	bool events = engine == SimulationEngine::EVENT || (engine == SimulationEngine::PARALLEL && parallel.getLookahead() < 1);
+	if (events) {
+		watchByGroup.resize(netlist->groupCount, -1);
+	}
+	if (waveform) {
+		for (Index bit = 0; bit < waveform->bitPins.size(); bit++) {
+			addWatch(waveform->bitPins[bit], bit, events);
+		}
+	}
+#if ICSIM_PROBES
+	for (Index probe = 0; probe < probes.size(); probe++) {
+		for (Index pin : probes[probe].pins) {
+			addWatch(pin, -probe - 1, events);
+		}
+	}
+#endif
+	if (watches.empty()) {
+		watchByGroup.clear();
+		return;
+	}
+
+	//starting values of the waveform
+	for (Index group = 0; group < watchByGroup.size(); group++) {
+		if (watchByGroup[group] != -1) {
+			recordGroup(group);
+		}
+	}
+	sampleWatches();
+}
+
+void Circuit::updateGroupHighCounts() {
+	std::fill(state.groupHighCount.begin(), state.groupHighCount.end(), 0);
+	for (Index driver : netlist->groupDrivers) {
+		if (state.pinStates[driver]) {
+			state.groupHighCount[netlist->groupByPin[driver]]++;
+		}
+	}
+}
+
+void Circuit::updateGroup(Index group, Index source) {
+	bool value = getGroupValue(group);
+	Index end = netlist->groupTapOffsets[group + 1];
+	for (Index i = netlist->groupTapOffsets[group]; i < end; i++) {
+		Index tap = netlist->groupTaps[i];
+		if (tap != source) {
+			state.pinStates[tap] = value;
+		}
+	}
+
+	end = netlist->groupReceiverOffsets[group + 1];
+	for (Index i = netlist->groupReceiverOffsets[group]; i < end; i++) {
+		addPinToQueue(netlist->groupReceivers[i]);
 	}
 }
 
 void Circuit::addPinToQueue(Index pin, int delay, bool external) {
-	queue.add(pin, simulationTime + delay, external);
+	state.queue.add(pin, state.simulationTime + delay, external);
 }
 
 void Circuit::addOutboundPinsToQueue(Index pin) {
-	Index destination = outboundPin[pin];
+	Index destination = netlist->outboundPin[pin];
 	if (destination == -1) {
 		return;
 	}
 	else if (destination == -2) {
-		for (auto& p : outboundPins[pin]) {
-			addPinToQueue(p);
-		}
-
-		auto groupIndex = groupByPin[pin];
-		groupUpToDate[groupIndex] = false;
+		updateGroup(netlist->groupByPin[pin], pin);
 	}
 	else {
 		addPinToQueue(destination);
 	}
 }
 
-int Circuit::processQueue(int timeUnits) {
-	int64_t startSimulationTime = simulationTime;
-	int64_t endSimulationTime = simulationTime;
+bool Circuit::processBlock(Index pin) {
+	const Block& block = netlist->getBlock(pin);
+	bool changed = false;
+	evaluateBlock(block, state.pinStates.data(), state.blockMemory.data() + block.memoryOffset, [&](Index output, uint8_t value) {
+		if (state.pinStates[output] != value) {
+			changed = true;
+			state.pinStates[output] = value;
+			updateGroupHighCount(output, value);
+			addOutboundPinsToQueue(output);
+			if (!scopeByPin.empty()) {
+				recordScopeChange(output);
+			}
+		}
+	});
+	return changed;
+}
+
+void Circuit::processExternalEvent(Index pin) {
+	if (netlist->pins[pin] == PinType::CONNECTOR && netlist->groupByPin[pin] != -1) {
+		state.groupForced[netlist->groupByPin[pin]] = state.pinStates[pin];
+		if (!watchByGroup.empty()) {
+			recordGroup(netlist->groupByPin[pin]);
+		}
+	}
+	addOutboundPinsToQueue(pin);
+}
+
+void Circuit::processClockEdges() {
+	int64_t time = nextClockEdge;
+	nextClockEdge = INT64_MAX;
+	//every edge starts a new clock phase for the glitch counts
+	phase++;
+	for (auto& clock : clocks) {
+		if (clock.nextEdge == time) {
+			clock.value = !clock.value;
+			clock.nextEdge += clock.value ? clock.highTime : clock.period - clock.highTime;
+			stats.clockEdges++;
+			if (state.pinStates[clock.pin] != clock.value) {
+				setPinState(clock.pin, clock.value);
+				processExternalEvent(clock.pin);
+			}
+		}
+		nextClockEdge = std::min(nextClockEdge, clock.nextEdge);
+	}
+}
+
+bool Circuit::isStopConditionMet() {
+	for (auto& condition : stopConditions) {
+		if (condition.bus.getValue() == condition.value) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int Circuit::processQueue(int timeUnits, bool fillTime) {
+	int64_t startSimulationTime = state.simulationTime;
+	int64_t endSimulationTime = state.simulationTime;
 	if (timeUnits != -1) {
 		endSimulationTime += timeUnits;
 	}
 
-	while (!queue.empty()) {
-		auto event = queue.get();
+	//clock edges are taken before any queued event with a later time, only by runs with a time limit
+	bool takeClockEdges = !clocks.empty() && timeUnits != -1 && fillTime;
+	stopped = false;
+
+	while (true) {
+		bool hasEvent = !state.queue.empty();
+		EventQueue::Event event;
+		if (hasEvent) {
+			event = state.queue.get();
+		}
+		if (takeClockEdges && nextClockEdge <= endSimulationTime && (!hasEvent || event.time > nextClockEdge)) {
+			if (state.simulationTime < nextClockEdge) {
+				state.simulationTime = nextClockEdge;
+			}
+			if (isStopConditionMet()) {
+				stopped = true;
+				break;
+			}
+			processClockEdges();
+			continue;
+		}
+		if (!hasEvent) {
+			break;
+		}
 
-		//assert(event.time >= simulationTime && "a gate was updated to late");
+		//assert(event.time >= state.simulationTime && "a gate was updated to late");
 		if (timeUnits != -1 && event.time > endSimulationTime) {
 			break;
 		}
-		if (event.time > simulationTime) {
-			simulationTime = event.time;
+		if (event.time > state.simulationTime) {
+			state.simulationTime = event.time;
 		}
 
-		queue.pop();
+		int64_t queueDepth = state.queue.size();
+		stats.queueDepthSum += queueDepth;
+		if (queueDepth > stats.peakQueueDepth) {
+			stats.peakQueueDepth = queueDepth;
+		}
+		stats.events++;
+		state.queue.pop();
 
 		Index pin = event.pin;
-		PinType type = pins[pin];
-		PinBaseType baseType = getPinBaseType(type);
+		const PinDescriptor& descriptor = netlist->pinDescriptors[pin];
 
 		if (event.external) {
-			addOutboundPinsToQueue(pin);
+			stats.externalEvents++;
+			processExternalEvent(pin);
 			continue;
 		}
 
-		switch (baseType)
+		stats.eventsByPinType[(int)descriptor.type]++;
+		if (!scopeByPin.empty()) {
+			scopeEvents[scopeByPin[pin]]++;
+		}
+		switch (descriptor.baseType)
 		{
 		case PinBaseType::CONNECTOR: {
-			if (type == PinType::CONNECTOR) {
-				pinStates[pin] = getInboundSignal(pin);
+			if (descriptor.type == PinType::CONNECTOR) {
+				state.pinStates[pin] = getInboundSignal(pin, stats);
 			}
-			else if (type == PinType::OUTPUT) {
+			else if (descriptor.type == PinType::OUTPUT) {
 				addOutboundPinsToQueue(pin);
 			}
 			break;
 		}
 		case PinBaseType::INPUT: {
-			bool oldValue = pinStates[pin];
-			pinStates[pin] = getInboundSignal(pin);
-			if (oldValue != pinStates[pin]) {
-				switch (type)
-				{
-				case PinType::CONNECTOR:
-					break;
-				case PinType::OUTPUT:
-					break;
-				case PinType::BUF_IN:
-					addPinToQueue(pin + 1, gateDelays[(int)GateType::BUF]);
-					break;
-				case PinType::BUF_OUT:
-					break;
-				case PinType::NOT_IN:
-					addPinToQueue(pin + 1, gateDelays[(int)GateType::NOT]);
-					break;
-				case PinType::NOT_OUT:
-					break;
-				case PinType::OR_A:
-					addPinToQueue(pin + 2, gateDelays[(int)GateType::OR]);
-					break;
-				case PinType::OR_B:
-					addPinToQueue(pin + 1, gateDelays[(int)GateType::OR]);
-					break;
-				case PinType::OR_OUT:
-					break;
-				case PinType::AND_A:
-					addPinToQueue(pin + 2, gateDelays[(int)GateType::AND]);
-					break;
-				case PinType::AND_B:
-					addPinToQueue(pin + 1, gateDelays[(int)GateType::AND]);
-					break;
-				case PinType::AND_OUT:
-					break;
-				case PinType::NOR_A:
-					addPinToQueue(pin + 2, gateDelays[(int)GateType::NOR]);
-					break;
-				case PinType::NOR_B:
-					addPinToQueue(pin + 1, gateDelays[(int)GateType::NOR]);
-					break;
-				case PinType::NOR_OUT:
-					break;
-				case PinType::NAND_A:
-					addPinToQueue(pin + 2, gateDelays[(int)GateType::NAND]);
-					break;
-				case PinType::NAND_B:
-					addPinToQueue(pin + 1, gateDelays[(int)GateType::NAND]);
-					break;
-				case PinType::NAND_OUT:
-					break;
-				case PinType::XOR_A:
-					addPinToQueue(pin + 2, gateDelays[(int)GateType::XOR]);
-					break;
-				case PinType::XOR_B:
-					addPinToQueue(pin + 1, gateDelays[(int)GateType::XOR]);
-					break;
-				case PinType::XOR_OUT:
-					break;
-				case PinType::D_LATCH_DATA:
-					addPinToQueue(pin + 2, gateDelays[(int)GateType::D_LATCH]);
-					break;
-				case PinType::D_LATCH_ENABLE:
-					addPinToQueue(pin + 1, gateDelays[(int)GateType::D_LATCH]);
-					break;
-				case PinType::D_LATCH_OUT:
-					break;
-				case PinType::DISABLED:
-					break;
-				default:
-					break;
-				}
+			uint8_t value = getInboundSignal(pin, stats);
+			if (state.pinStates[pin] != value) {
+				state.pinStates[pin] = value;
+				addPinToQueue(pin + descriptor.offset, descriptor.delay);
+			}
+			else {
+				stats.unchangedEvents++;
 			}
 			break;
 		}
 		case PinBaseType::OUTPUT: {
-			bool oldValue = pinStates[pin];
-			switch (type)
-			{
-			case PinType::CONNECTOR:
-				break;
-			case PinType::OUTPUT:
-				break;
-			case PinType::BUF_IN:
-				break;
-			case PinType::BUF_OUT:
-				pinStates[pin] = pinStates[pin - 1];
-				break;
-			case PinType::NOT_IN:
-				break;
-			case PinType::NOT_OUT:
-				pinStates[pin] = !pinStates[pin - 1];
-				break;
-			case PinType::OR_A:
-				break;
-			case PinType::OR_B:
-				break;
-			case PinType::OR_OUT:
-				pinStates[pin] = pinStates[pin - 2] || pinStates[pin - 1];
-				break;
-			case PinType::AND_A:
-				break;
-			case PinType::AND_B:
-				break;
-			case PinType::AND_OUT:
-				pinStates[pin] = pinStates[pin - 2] && pinStates[pin - 1];
-				break;
-			case PinType::NOR_A:
-				break;
-			case PinType::NOR_B:
-				break;
-			case PinType::NOR_OUT:
-				pinStates[pin] = !(pinStates[pin - 2] || pinStates[pin - 1]);
-				break;
-			case PinType::NAND_A:
-				break;
-			case PinType::NAND_B:
-				break;
-			case PinType::NAND_OUT:
-				pinStates[pin] = !(pinStates[pin - 2] && pinStates[pin - 1]);
-				break;
-			case PinType::XOR_A:
-				break;
-			case PinType::XOR_B:
-				break;
-			case PinType::XOR_OUT:
-				pinStates[pin] = pinStates[pin - 2] ^ pinStates[pin - 1];
-				break;
-			case PinType::D_LATCH_DATA:
-				break;
-			case PinType::D_LATCH_ENABLE:
-				break;
-			case PinType::D_LATCH_OUT:
-				if (pinStates[pin - 1]) {
-					pinStates[pin] = pinStates[pin - 2];
+			uint8_t oldValue = state.pinStates[pin];
+			int index = (oldValue << 2) | (state.pinStates[pin + descriptor.offset] << 1) | state.pinStates[pin - 1];
+			uint8_t value = (descriptor.truthTable >> index) & 1;
+			if (oldValue != value) {
+				state.pinStates[pin] = value;
+				updateGroupHighCount(pin, value);
+				addOutboundPinsToQueue(pin);
+				if (!scopeByPin.empty()) {
+					recordScopeChange(pin);
 				}
-				break;
-			case PinType::DISABLED:
-				break;
-			default:
-				break;
 			}
-			if (oldValue != pinStates[pin]) {
-				addOutboundPinsToQueue(pin);
+			else {
+				stats.unchangedEvents++;
+			}
+			break;
+		}
+		case PinBaseType::BLOCK_INPUT: {
+			uint8_t value = getInboundSignal(pin, stats);
+			if (state.pinStates[pin] != value) {
+				state.pinStates[pin] = value;
+				addPinToQueue(netlist->getBlock(pin).getOutputPin(), descriptor.delay);
+			}
+			else {
+				stats.unchangedEvents++;
+			}
+			break;
+		}
+		case PinBaseType::BLOCK_OUTPUT: {
+			if (!processBlock(pin)) {
+				stats.unchangedEvents++;
 			}
 			break;
 		}
@@ -487,9 +1101,10 @@ int Circuit::processQueue(int timeUnits) {
 		}
 	}
 
-	int timeNeeded = simulationTime - startSimulationTime;
-	if (simulationTime < endSimulationTime) {
-		simulationTime = endSimulationTime;
+	int timeNeeded = state.simulationTime - startSimulationTime;
+	//pending events are behind the end, so the time always moves to the end then
+	if (state.simulationTime < endSimulationTime && (fillTime || !state.queue.empty()) && !stopped) {
+		state.simulationTime = endSimulationTime;
 	}
 	return timeNeeded;
 }
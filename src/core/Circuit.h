@@ -6,19 +6,70 @@
 
 #include "type.h"
 #include "EventQueue.h"
+#include "Netlist.h"
+#include "SimulationState.h"
+#include "Snapshot.h"
+#include "LevelizedSimulator.h"
+#include "ParallelSimulator.h"
 #include "Pin.h"
 #include "Bus.h"
+#include "SubCircuit.h"
+#include "WaveformWriter.h"
+#include "Probe.h"
+#include "SimulationStats.h"
 
 #include <vector>
 #include <map>
+#include <memory>
+
+class PrepareTimings {
+public:
+	double groups = 0;
+	double connections = 0;
+	double initialState = 0;
+	double total = 0;
+};
 
 class Circuit {
 public:
 	Index addGate(GateType type);
 	void addLine(Index pinA, Index pinB);
+	//memory block with wordCount words of dataSize bits (see Block.h), returns the first pin
+	Index addRam(int addressSize, int dataSize, int64_t wordCount);
+	//word level block (WORD_ADD, WORD_LATCH, WORD_DECODER, WORD_AND) of size bits (see Block.h), returns the first pin
+	//for WORD_DECODER size is the number of select bits
+	Index addBlock(GateType type, int size);
+	//modules (see Module.h), a definition is built once in its own circuit and instanced many times
+	//only the lines of a module are stored once, the instances cost as many gates and pins as the definition
+	//ports name buses of the definition, a module with the same name is only defined once
+	Index addModule(const std::string& name, const Circuit& definition, const std::map<std::string, Bus>& ports);
+	//copies the pins, blocks and constant pins of the module, the lines of the module are not copied
+	SubCircuit addInstance(Index module);
 
+	//removes constant, duplicate and dead gates without changing the timing, called before prepare, module instances are expanded first
+	//the output pin of a removed gate becomes a connector on the net it is equal to, reading it gives the same values as before,
+	//but setting it from outside also sets that net, put a connector on a gate output before optimizing to keep the gate
+	void optimize();
 	void prepare();
 	int simulate(int timeUnits = -1);
+	//runs until no events are left and returns the time units that took, the time is not advanced past the last event
+	//returns -1 if the circuit did not settle within maxTimeUnits (like an oscillating loop), the time is then advanced by maxTimeUnits
+	//the levelized engine has zero delay and returns 0, maxTimeUnits limits its sweeps (see SimulationStats::sweeps)
+	int settle(int maxTimeUnits = 10000);
+	//no events are pending, on the levelized engine the last run did not hit the sweep limit
+	bool isSettled();
+
+	//clock source toggled by the engine itself, the pin goes high phase time units from now and then stays high for highTime of every period
+	//edges are only taken by simulate(timeUnits), settle and simulate() without a limit leave the clocks where they are
+	//clocks run on the event driven engine, the circuit is switched to it, they are not part of snapshots
+	//returns the clock index or -1 for an invalid timing
+	Index addClock(Pin pin, int period, int highTime, int phase = 0);
+	void removeClocks();
+	//simulate stops at the first clock edge at which the bus has the value, before the edge is applied
+	void addStopCondition(Bus bus, uint64_t value);
+	void removeStopConditions();
+	//the last simulate call ended at a stop condition
+	bool isStopped();
 
 	int getGateCount();
 	int getPinCount();
@@ -26,6 +77,70 @@ public:
 	int64_t getSimulationTime();
 	void setGateDelay(GateType type, int delay);
 	void setSimulationMode(bool sortQueue);
+	//the levelized engine does not support blocks, circuits with blocks stay on the event driven engine
+	void setSimulationEngine(SimulationEngine engine);
+	//number of independent lanes simulated at once (1 to 64), needs the levelized engine
+	//returns the number of lanes that are simulated, 1 on the other engines and for circuits with blocks or clocks,
+	//which run on the event driven engine, the count is kept for a later switch to the levelized engine
+	int setLaneCount(int count);
+	int getLaneCount();
+	//number of worker threads used by the parallel engine
+	void setThreadCount(int count);
+	int getThreadCount();
+	void setEventDeduplication(bool enabled);
+	//events added to the queue, the processed events are counted in getStats
+	int64_t getQueuedEventCount();
+	int64_t getSkippedEventCount();
+	//engine counters since the last resetStats, prepare starts them at zero (see SimulationStats.h)
+	const SimulationStats& getStats();
+	void resetStats();
+	//writes the counters as one json line
+	void dumpStats(FILE* file = stdout);
+	//names the gates added until the matching popScope, nested names are joined with '/' ("cpu/alu")
+	void pushScope(const std::string& name);
+	void popScope();
+	//events and glitches per scope since resetStats, most events first
+	//only the event driven engine counts them, the other engines leave them at zero
+	std::vector<ScopeActivity> getScopeActivity();
+	void dumpScopeActivity(FILE* file = stdout);
+	const PrepareTimings& getPrepareTimings();
+	const OptimizationStats& getOptimizationStats();
+	std::vector<ModuleStats> getModuleStats();
+
+	//the prepared netlist can back any number of circuits, each only holds its own simulation state
+	//changing a shared netlist (adding gates, gate delays) makes a private copy first
+	std::shared_ptr<Netlist> getNetlist();
+	void setNetlist(std::shared_ptr<Netlist> netlist);
+	//binary netlist files, loading replaces build and prepare
+	bool saveNetlist(const std::string& file);
+	bool loadNetlist(const std::string& file, bool validateHash = true);
+
+	//saves and restores the complete simulation state, a snapshot fits every circuit on the same netlist
+	Snapshot snapshot();
+	void snapshot(Snapshot& snapshot);
+	bool restore(const Snapshot& snapshot);
+
+	bool getPinValue(Index pin);
+	void setPinValue(Index pin, bool value);
+	//one bit per lane, lanes that are not simulated (see getLaneCount) read as 0
+	uint64_t getPinLanes(Index pin);
+	//sets the simulated lanes selected by mask, returns false and sets nothing when the mask selects none of them
+	bool setPinLanes(Index pin, uint64_t lanes, uint64_t mask = ~0ull);
+	//contents of the block containing the pin, changes are seen by the next evaluation of the block
+	uint8_t* getBlockMemory(Index pin);
+
+	//records the net values of the writer signals, nullptr stops recording
+	//the writer has to be open, returns false and records nothing otherwise
+	//the event driven engine records every change at its time, the other engines record the values at the end of simulate
+	bool setWaveformWriter(WaveformWriter* writer);
+
+	//arms a probe that keeps the last depth transitions of the pins, returns the probe index (see Probe.h)
+	//probes are recorded like waveforms and cost nothing while none is armed, without ICSIM_PROBES they are not recorded
+	Index addProbe(const std::string& name, Bus bus, int depth = 64);
+	Index addProbe(const std::string& name, Pin pin, int depth = 64);
+	Probe& getProbe(Index probe);
+	void removeProbes();
+	void dumpProbes(FILE* file = stdout);
 
 	Pin pin() {
 		return Pin(this);
@@ -40,35 +155,101 @@ public:
 private:
 	friend class Pin;
 	friend class CircuitSimulator;
+	friend class LevelizedSimulator;
+	friend class ParallelSimulator;
+
+	//topology, shared with other circuits after prepare
+	std::shared_ptr<Netlist> netlist = std::make_shared<Netlist>();
+	SimulationState state;
 
-	//circuit definition
-	std::vector<PinType> pins;
-	std::vector<bool> pinStates;
-	std::vector<Index> changedPins;
-	std::vector<std::pair<Index, Index>> lines;
-	int gateCount = 0;
+	//simulation
+	PrepareTimings prepareTimings;
+	OptimizationStats optimizationStats;
+	SimulationStats stats;
+	//queue counters at the last resetStats
+	int64_t statsAddedCount = 0;
+	int64_t statsSkippedCount = 0;
 
-	//propergation groups
-	std::vector<Index> inboundPin;
-	std::map<Index, std::set<Index>> inboundPins;
-	std::vector<Index> outboundPin;
-	std::map<Index, std::set<Index>> outboundPins;
+	//open scopes while building, indices into netlist->scopes
+	std::vector<Index> scopeStack;
+	//activity per scope, empty while the netlist has no scopes
+	std::vector<Index> scopeByPin;
+	std::vector<int64_t> scopeEvents;
+	std::vector<int64_t> scopeGlitches;
+	//phase (simulate call or clock edge) of the last change of a pin shifted left by one, the lowest bit is set after an odd number of changes
+	std::vector<uint64_t> pinPhases;
+	uint64_t phase = 1;
+	SimulationEngine engine = SimulationEngine::EVENT;
+	int laneCount = 1;
+	LevelizedSimulator levelized;
+	int threadCount = 1;
+	ParallelSimulator parallel;
 
-	std::vector<std::set<Index>> groups;
-	std::vector<Index> groupByPin;
-	std::vector<bool> groupUpToDate;
-	std::vector<bool> groupValues;
+	//a pin recorded for the waveform writer or a probe
+	class Watch {
+	public:
+		Index pin = -1;
+		//waveform bit, or -probe - 1
+		Index target = 0;
+		//next watch on the same net
+		Index next = -1;
+		uint8_t value = 0;
+	};
 
-	//simulation
-	EventQueue queue;
-	int64_t simulationTime = 0;
-	std::vector<int> gateDelays;
+	class ClockSource {
+	public:
+		Index pin = -1;
+		int period = 0;
+		int highTime = 0;
+		int64_t nextEdge = 0;
+		bool value = false;
+	};
+
+	class StopCondition {
+	public:
+		Bus bus;
+		uint64_t value = 0;
+	};
+
+	std::vector<ClockSource> clocks;
+	int64_t nextClockEdge = INT64_MAX;
+	std::vector<StopCondition> stopConditions;
+	bool stopped = false;
+
+	//recording of waveforms and probes, watches on a net are chained from the net, empty while nothing is recorded
+	WaveformWriter* waveform = nullptr;
+	std::vector<Probe> probes;
+	std::vector<Watch> watches;
+	std::vector<Index> watchByGroup;
+	//watches without a net and all watches on the engines without events, recorded at the end of simulate
+	std::vector<Index> sampledWatches;
 
 	Index addPin(PinType type);
-	void addPinConnection(Index pinA, Index pinB);
-	void initPinConnections();
-	bool getInboundSignal(Index pin);
+	Index addBlock(Block block);
+	Netlist& editNetlist();
+	void initEngine();
+	//fillTime advances the time to the end of timeUnits even when the events ended earlier
+	int run(int timeUnits, bool fillTime);
+	void initWatches();
+	void initScopes();
+	void beginScope(Index scope);
+	void recordScopeChange(Index pin);
+	void addWatch(Index pin, Index target, bool events);
+	void recordGroup(Index group);
+	void recordWatch(Watch& watch, uint8_t value);
+	void sampleWatches();
+	bool getInboundSignal(Index pin, SimulationStats& stats);
+	bool getGroupValue(Index group);
+	void setPinState(Index pin, bool value);
+	void updateGroupHighCount(Index pin, bool value);
+	void updateGroup(Index group, Index source);
+	void updateGroupHighCounts();
 	void addPinToQueue(Index pin, int delay = 0, bool external = false);
 	void addOutboundPinsToQueue(Index pin);
-	int processQueue(int timeUnits = -1);
+	//returns true if an output changed
+	bool processBlock(Index pin);
+	void processExternalEvent(Index pin);
+	void processClockEdges();
+	bool isStopConditionMet();
+	int processQueue(int timeUnits = -1, bool fillTime = true);
 };
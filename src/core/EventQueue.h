@@ -5,9 +5,9 @@
 #pragma once
 
 #include "type.h"
-#include <set>
 #include <deque>
-#include <queue>
+#include <algorithm>
+#include <vector>
 
 class EventQueue {
 public:
@@ -17,49 +17,70 @@ public:
 		//was the pin set externaly
 		bool external = false;
 		int64_t time = 0;
-		int64_t insertIndex = 0;
-
-		bool operator<(const Event& e) const {
-			if (time == e.time) {
-				return insertIndex > e.insertIndex;
-			}
-			else {
-				return time > e.time;
-			}
-		}
 	};
 	std::deque<Event> updateQueue;
-	std::set<Index> updateSet;
-	std::priority_queue<Event> sortedUpdateQueue;
-	int64_t nextInsertIndex = 0;
-	bool useUpdateSet = false;
 	bool sortQueue = false;
 
+	//deduplication, a pin is not added again while it is still pending
+	//pendingPins covers the pins from pinOffset on
+	std::vector<uint8_t> pendingPins;
+	Index pinOffset = 0;
+	bool useUpdateSet = true;
+	int64_t addedCount = 0;
+	int64_t skippedCount = 0;
+
+	//timing wheel used in sorted mode, one slot per time unit
+	//each slot holds pin indices in insert order, external events are stored as -pin - 1
+	std::vector<std::vector<Index>> slots;
+	int64_t slotMask = 0;
+	int64_t currentTime = 0;
+	int64_t maxTime = 0;
+	int64_t readIndex = 0;
+	int64_t eventCount = 0;
+
+	EventQueue() {
+		resizeWheel(16);
+	}
+
+	void resize(Index pinCount, Index pinOffset = 0) {
+		this->pinOffset = pinOffset;
+		pendingPins.clear();
+		pendingPins.resize(pinCount, 0);
+	}
+
 	void add(Index pin, int64_t time, bool external) {
 		if (useUpdateSet) {
-			if (!updateSet.contains(pin)) {
-				if (sortQueue) {
-					sortedUpdateQueue.push({ pin, external, time, nextInsertIndex++ });
-				}
-				else {
-					updateQueue.push_back({ pin, external, time });
-				}
-				updateSet.insert(pin);
+			if (pendingPins[pin - pinOffset]) {
+				skippedCount++;
+				return;
 			}
+			pendingPins[pin - pinOffset] = 1;
+		}
+		addedCount++;
+		if (sortQueue) {
+			addSorted(pin, time, external);
 		}
 		else {
-			if (sortQueue) {
-				sortedUpdateQueue.push({ pin, external, time, nextInsertIndex++ });
-			}
-			else {
-				updateQueue.push_back({ pin, external, time });
-			}
+			updateQueue.push_back({ pin, external, time });
 		}
 	}
 
 	Event get() {
 		if (sortQueue) {
-			return sortedUpdateQueue.top();
+			auto* slot = &slots[currentTime & slotMask];
+			while (readIndex >= slot->size()) {
+				slot->clear();
+				readIndex = 0;
+				currentTime++;
+				slot = &slots[currentTime & slotMask];
+			}
+			Index value = (*slot)[readIndex];
+			if (value < 0) {
+				return { -value - 1, true, currentTime };
+			}
+			else {
+				return { value, false, currentTime };
+			}
 		}
 		else {
 			return updateQueue.front();
@@ -68,22 +89,118 @@ public:
 
 	void pop() {
 		if (useUpdateSet) {
-			updateSet.erase(get().pin);
+			pendingPins[get().pin - pinOffset] = 0;
 		}
 		if (sortQueue) {
-			sortedUpdateQueue.pop();
+			get();
+			readIndex++;
+			eventCount--;
 		}
 		else {
 			updateQueue.pop_front();
 		}
 	}
 
+	//appends all pending events in the order they will be processed
+	void getEvents(std::vector<Event>& events) {
+		if (!sortQueue) {
+			events.insert(events.end(), updateQueue.begin(), updateQueue.end());
+			return;
+		}
+		if (eventCount == 0) {
+			return;
+		}
+		for (int64_t time = currentTime; time <= maxTime; time++) {
+			auto& slot = slots[time & slotMask];
+			for (int64_t i = time == currentTime ? readIndex : 0; i < slot.size(); i++) {
+				Index value = slot[i];
+				if (value < 0) {
+					events.push_back({ -value - 1, true, time });
+				}
+				else {
+					events.push_back({ value, false, time });
+				}
+			}
+		}
+	}
+
+	//removes all events, the mode and counters are kept
+	void clear() {
+		updateQueue.clear();
+		for (auto& slot : slots) {
+			slot.clear();
+		}
+		currentTime = 0;
+		maxTime = 0;
+		readIndex = 0;
+		eventCount = 0;
+		std::fill(pendingPins.begin(), pendingPins.end(), 0);
+	}
+
 	bool empty() {
 		if (sortQueue) {
-			return sortedUpdateQueue.empty();
+			return eventCount == 0;
 		}
 		else {
 			return updateQueue.empty();
 		}
 	}
+
+	int64_t size() {
+		if (sortQueue) {
+			return eventCount;
+		}
+		else {
+			return updateQueue.size();
+		}
+	}
+
+private:
+	void addSorted(Index pin, int64_t time, bool external) {
+		if (eventCount == 0) {
+			slots[currentTime & slotMask].clear();
+			readIndex = 0;
+			currentTime = time;
+			maxTime = time;
+		}
+		else if (time < currentTime) {
+			//all slots before the current one are empty, so the wheel can be moved back
+			auto& slot = slots[currentTime & slotMask];
+			slot.erase(slot.begin(), slot.begin() + readIndex);
+			readIndex = 0;
+			if (maxTime - time > slotMask) {
+				resizeWheel(maxTime - time + 1);
+			}
+			currentTime = time;
+		}
+
+		if (time - currentTime > slotMask) {
+			resizeWheel(time - currentTime + 1);
+		}
+		if (time > maxTime) {
+			maxTime = time;
+		}
+
+		slots[time & slotMask].push_back(external ? -pin - 1 : pin);
+		eventCount++;
+	}
+
+	void resizeWheel(int64_t minSize) {
+		int64_t size = 1;
+		while (size < minSize) {
+			size *= 2;
+		}
+
+		std::vector<std::vector<Index>> newSlots(size);
+		if (eventCount > 0) {
+			for (int64_t time = currentTime; time <= maxTime; time++) {
+				auto& slot = slots[time & slotMask];
+				auto begin = time == currentTime ? slot.begin() + readIndex : slot.begin();
+				newSlots[time & (size - 1)].assign(begin, slot.end());
+			}
+			readIndex = 0;
+		}
+		slots.swap(newSlots);
+		slotMask = size - 1;
+	}
 };
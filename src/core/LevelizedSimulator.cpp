@@ -0,0 +1,363 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#include "LevelizedSimulator.h"
+#include "Circuit.h"
+#include <bit>
+#include <algorithm>
+
+void LevelizedSimulator::build(Circuit* circuit) {
+	this->circuit = circuit;
+	auto& netlist = *circuit->netlist;
+	auto& pins = netlist.pins;
+	Index groupCount = netlist.groupCount;
+
+	std::vector<NodeType> types;
+	std::vector<GateType> gates;
+	std::vector<Index> pinByNode;
+	std::vector<Index> groupByNodeUnordered;
+	std::vector<Index> nodeByPinUnordered(pins.size(), -1);
+	std::vector<Index> nodeByGroup(groupCount, -1);
+
+	auto addNode = [&](NodeType type, GateType gate, Index pin, Index group) {
+		types.push_back(type);
+		gates.push_back(gate);
+		pinByNode.push_back(pin);
+		groupByNodeUnordered.push_back(group);
+		return (Index)types.size() - 1;
+	};
+	auto getDriverCount = [&](Index group) {
+		return netlist.groupDriverOffsets[group + 1] - netlist.groupDriverOffsets[group];
+	};
+	auto getTapCount = [&](Index group) {
+		return netlist.groupTapOffsets[group + 1] - netlist.groupTapOffsets[group];
+	};
+
+	//gate outputs and external drivers
+	for (Index i = 0; i < pins.size(); i++) {
+		PinBaseType baseType = getPinBaseType(pins[i]);
+		if (baseType == PinBaseType::OUTPUT) {
+			nodeByPinUnordered[i] = addNode(NodeType::GATE, getGateType(pins[i]), i, -1);
+		}
+		else if (pins[i] == PinType::OUTPUT || pins[i] == PinType::DISABLED) {
+			nodeByPinUnordered[i] = addNode(NodeType::SOURCE, GateType::CONNECTOR, i, -1);
+		}
+	}
+
+	//nets with multiple drivers or taps, nets with a single driver use the driver directly
+	for (Index group = 0; group < groupCount; group++) {
+		if (getDriverCount(group) > 1 || getTapCount(group) > 0) {
+			nodeByGroup[group] = addNode(NodeType::NET, GateType::CONNECTOR, -1, group);
+		}
+		else if (getDriverCount(group) == 1) {
+			nodeByGroup[group] = nodeByPinUnordered[netlist.groupDrivers[netlist.groupDriverOffsets[group]]];
+		}
+	}
+
+	//input and connector pins read their net, pins without a driving net keep their own value
+	for (Index i = 0; i < pins.size(); i++) {
+		if (nodeByPinUnordered[i] == -1) {
+			Index group = netlist.groupByPin[i];
+			if (group != -1 && nodeByGroup[group] != -1) {
+				nodeByPinUnordered[i] = nodeByGroup[group];
+			}
+			else {
+				nodeByPinUnordered[i] = addNode(NodeType::SOURCE, GateType::CONNECTOR, i, -1);
+			}
+		}
+	}
+
+	//edges
+	Index nodeCount = types.size();
+	std::vector<std::vector<Index>> edges(nodeCount);
+	for (Index node = 0; node < nodeCount; node++) {
+		if (types[node] == NodeType::GATE) {
+			Index pin = pinByNode[node];
+			Index a = nodeByPinUnordered[pin + netlist.pinDescriptors[pin].offset];
+			Index b = nodeByPinUnordered[pin - 1];
+			edges[a].push_back(node);
+			if (b != a) {
+				edges[b].push_back(node);
+			}
+		}
+		else if (types[node] == NodeType::NET) {
+			Index group = groupByNodeUnordered[node];
+			for (Index i = netlist.groupDriverOffsets[group]; i < netlist.groupDriverOffsets[group + 1]; i++) {
+				edges[nodeByPinUnordered[netlist.groupDrivers[i]]].push_back(node);
+			}
+		}
+	}
+
+	//topological order by reverse post order of a depth first search, edges back into the stack are feedback edges
+	std::vector<Index> order;
+	order.reserve(nodeCount);
+	std::vector<uint8_t> visited(nodeCount, 0);
+	std::vector<std::pair<Index, Index>> stack;
+	for (int pass = 0; pass < 2; pass++) {
+		//start at the sources first, so that feedback edges are cut as late as possible
+		for (Index root = 0; root < nodeCount; root++) {
+			if (visited[root] || (pass == 0 && types[root] != NodeType::SOURCE)) {
+				continue;
+			}
+			visited[root] = 1;
+			stack.push_back({ root, 0 });
+			while (!stack.empty()) {
+				auto& top = stack.back();
+				if (top.second < edges[top.first].size()) {
+					Index next = edges[top.first][top.second++];
+					if (!visited[next]) {
+						visited[next] = 1;
+						stack.push_back({ next, 0 });
+					}
+				}
+				else {
+					order.push_back(top.first);
+					stack.pop_back();
+				}
+			}
+		}
+	}
+	std::vector<Index> rank(nodeCount);
+	for (Index i = 0; i < nodeCount; i++) {
+		rank[order[nodeCount - 1 - i]] = i;
+	}
+
+	//store nodes in rank order
+	nodeTypes.assign(nodeCount, NodeType::SOURCE);
+	nodeGates.assign(nodeCount, GateType::CONNECTOR);
+	nodeInputA.assign(nodeCount, -1);
+	nodeInputB.assign(nodeCount, -1);
+	netDrivers.clear();
+	values.assign(nodeCount, 0);
+	driverValues.assign(nodeCount, 0);
+	forcedValues.assign(nodeCount, 0);
+	fanoutOffsets.assign(nodeCount + 1, 0);
+	fanout.clear();
+	groupByNode.assign(nodeCount, -1);
+
+	nodeByPin.resize(pins.size());
+	for (Index i = 0; i < pins.size(); i++) {
+		nodeByPin[i] = rank[nodeByPinUnordered[i]];
+	}
+
+	std::vector<Index> nodeByRank(nodeCount);
+	for (Index node = 0; node < nodeCount; node++) {
+		nodeByRank[rank[node]] = node;
+	}
+	for (Index r = 0; r < nodeCount; r++) {
+		Index node = nodeByRank[r];
+		nodeTypes[r] = types[node];
+		nodeGates[r] = gates[node];
+		groupByNode[r] = groupByNodeUnordered[node];
+		if (types[node] == NodeType::GATE) {
+			Index pin = pinByNode[node];
+			nodeInputA[r] = nodeByPin[pin + netlist.pinDescriptors[pin].offset];
+			nodeInputB[r] = nodeByPin[pin - 1];
+			values[r] = circuit->state.pinStates[pin] ? laneMask : 0;
+		}
+		else if (types[node] == NodeType::NET) {
+			Index group = groupByNodeUnordered[node];
+			nodeInputA[r] = netDrivers.size();
+			for (Index i = netlist.groupDriverOffsets[group]; i < netlist.groupDriverOffsets[group + 1]; i++) {
+				netDrivers.push_back(nodeByPin[netlist.groupDrivers[i]]);
+			}
+			nodeInputB[r] = netDrivers.size();
+			forcedValues[r] = circuit->state.groupForced[group] ? laneMask : 0;
+		}
+		else {
+			values[r] = circuit->state.pinStates[pinByNode[node]] ? laneMask : 0;
+		}
+
+		for (Index next : edges[node]) {
+			fanout.push_back(rank[next]);
+		}
+		fanoutOffsets[r + 1] = fanout.size();
+	}
+
+	//net values from the current driver states, so that feedback edges read correct values
+	for (Index r = 0; r < nodeCount; r++) {
+		if (nodeTypes[r] == NodeType::NET) {
+			for (Index i = nodeInputA[r]; i < nodeInputB[r]; i++) {
+				driverValues[r] |= values[netDrivers[i]];
+			}
+			values[r] = driverValues[r] | forcedValues[r];
+		}
+	}
+
+	//settle once from the current pin states
+	dirty.assign((nodeCount + 63) / 64, 0);
+	restartWord = dirty.size();
+	lastWord = -1;
+	for (Index r = 0; r < nodeCount; r++) {
+		if (nodeTypes[r] != NodeType::SOURCE) {
+			markDirty(r);
+		}
+	}
+	settle(maxSweeps);
+}
+
+void LevelizedSimulator::setPin(Index pin, uint64_t value, uint64_t mask) {
+	Index node = nodeByPin[pin];
+	mask &= laneMask;
+	PinType type = circuit->netlist->pins[pin];
+
+	if (nodeTypes[node] == NodeType::NET) {
+		if (type == PinType::CONNECTOR) {
+			forcedValues[node] = (forcedValues[node] & ~mask) | (value & mask);
+			markDirty(node);
+		}
+	}
+	else if (nodeTypes[node] == NodeType::SOURCE || getPinBaseType(type) == PinBaseType::OUTPUT) {
+		setValue(node, (values[node] & ~mask) | (value & mask));
+	}
+}
+
+uint64_t LevelizedSimulator::getPin(Index pin) {
+	return values[nodeByPin[pin]];
+}
+
+void LevelizedSimulator::writePinStates() {
+	for (Index i = 0; i < nodeByPin.size(); i++) {
+		circuit->state.pinStates[i] = values[nodeByPin[i]] & 1;
+	}
+	for (Index r = 0; r < nodeTypes.size(); r++) {
+		if (nodeTypes[r] == NodeType::NET) {
+			circuit->state.groupForced[groupByNode[r]] = forcedValues[r] & 1;
+		}
+	}
+}
+
+void LevelizedSimulator::snapshot(Snapshot& snapshot) {
+	snapshot.nodeValues = values;
+	snapshot.nodeDriverValues = driverValues;
+	snapshot.nodeForcedValues = forcedValues;
+	snapshot.nodeDirty = dirty;
+	snapshot.laneMask = laneMask;
+}
+
+bool LevelizedSimulator::restore(const Snapshot& snapshot) {
+	if (snapshot.nodeValues.size() != values.size() || snapshot.laneMask != laneMask) {
+		return false;
+	}
+	values = snapshot.nodeValues;
+	driverValues = snapshot.nodeDriverValues;
+	forcedValues = snapshot.nodeForcedValues;
+	dirty = snapshot.nodeDirty;
+	restartWord = dirty.size();
+	lastWord = -1;
+	for (Index word = 0; word < dirty.size(); word++) {
+		if (dirty[word]) {
+			restartWord = std::min(restartWord, word);
+			lastWord = word;
+		}
+	}
+	return true;
+}
+
+int LevelizedSimulator::settle(int sweepLimit) {
+	int sweeps = 0;
+	Index wordCount = dirty.size();
+	settling = true;
+	unstable = false;
+	while (restartWord < wordCount) {
+		if (sweeps >= sweepLimit) {
+			unstable = true;
+			break;
+		}
+		sweeps++;
+
+		Index start = restartWord;
+		restartWord = wordCount;
+		for (currentWord = start; currentWord <= lastWord; currentWord++) {
+			uint64_t bits;
+			while ((bits = dirty[currentWord]) != 0) {
+				int bit = std::countr_zero(bits);
+				dirty[currentWord] &= ~(1ull << bit);
+				evaluate(currentWord * 64 + bit);
+			}
+		}
+	}
+	settling = false;
+	lastWord = -1;
+	return sweeps;
+}
+
+void LevelizedSimulator::markDirty(Index node) {
+	Index word = node / 64;
+	dirty[word] |= 1ull << (node % 64);
+	//nodes behind the current sweep position need another sweep
+	if ((!settling || word < currentWord) && word < restartWord) {
+		restartWord = word;
+	}
+	if (word > lastWord) {
+		lastWord = word;
+	}
+}
+
+void LevelizedSimulator::evaluate(Index node) {
+	evaluationCount++;
+	uint64_t old = values[node];
+	uint64_t value = old;
+
+	if (nodeTypes[node] == NodeType::GATE) {
+		uint64_t a = values[nodeInputA[node]];
+		uint64_t b = values[nodeInputB[node]];
+		switch (nodeGates[node])
+		{
+		case GateType::BUF:
+			value = a;
+			break;
+		case GateType::NOT:
+			value = ~a;
+			break;
+		case GateType::OR:
+			value = a | b;
+			break;
+		case GateType::AND:
+			value = a & b;
+			break;
+		case GateType::NOR:
+			value = ~(a | b);
+			break;
+		case GateType::NAND:
+			value = ~(a & b);
+			break;
+		case GateType::XOR:
+			value = a ^ b;
+			break;
+		case GateType::D_LATCH:
+			value = (b & a) | (~b & old);
+			break;
+		default:
+			break;
+		}
+	}
+	else if (nodeTypes[node] == NodeType::NET) {
+		uint64_t driverValue = 0;
+		Index end = nodeInputB[node];
+		for (Index i = nodeInputA[node]; i < end; i++) {
+			driverValue |= values[netDrivers[i]];
+		}
+		//a driver change overwrites the value set from outside in the lanes that changed
+		if (driverValue != driverValues[node]) {
+			forcedValues[node] &= ~(driverValue ^ driverValues[node]);
+			driverValues[node] = driverValue;
+		}
+		value = driverValue | forcedValues[node];
+	}
+
+	setValue(node, value & laneMask);
+}
+
+void LevelizedSimulator::setValue(Index node, uint64_t value) {
+	if (values[node] == value) {
+		return;
+	}
+	values[node] = value;
+
+	Index end = fanoutOffsets[node + 1];
+	for (Index i = fanoutOffsets[node]; i < end; i++) {
+		markDirty(fanout[i]);
+	}
+}
@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "type.h"
+#include "Block.h"
+#include <vector>
+#include <string>
+#include <map>
+
+//placement of a module, the pins of the instance start at firstPin
+class ModuleInstance {
+public:
+	Index module = -1;
+	Index firstPin = 0;
+};
+
+//a subcircuit that is defined once and instanced many times (see Circuit::addModule)
+//only the lines are shared, pins, blocks and constant pins are copied into every instance
+//pin states, descriptors and group tables stay per pin, so gates, pins, memory and prepare time still grow with the instance count
+//like a circuit built gate by gate, the port lines of every instance even add lines on top
+//what shrinks are the stored lines, the nets of a module are joined once and placed at every instance when the netlist is prepared
+//optimize and saving a netlist file expand the instances into plain lines
+//all pin indices are relative to the first pin of an instance
+class Module {
+public:
+	std::string name;
+	std::vector<PinType> pins;
+	std::vector<std::pair<Index, Index>> lines;
+	std::vector<Index> constantPins;
+	std::vector<Block> blocks;
+	//modules instanced within the definition, they always have a lower index than this module
+	std::vector<ModuleInstance> instances;
+	std::map<std::string, std::vector<Index>> ports;
+	//nets within one instance including nested modules, the root pin of the net for each pin, -1 for pins without lines
+	std::vector<Index> netRoots;
+	//including nested modules
+	int gateCount = 0;
+	int64_t lineCount = 0;
+};
+
+class ModuleStats {
+public:
+	std::string name;
+	//including instances within other modules
+	int64_t instanceCount = 0;
+	//per instance, including nested modules
+	int gates = 0;
+	int pins = 0;
+	int64_t lines = 0;
+	//lines stored by the definition itself
+	int64_t storedLines = 0;
+	//over all instances
+	int64_t totalGates = 0;
+	int64_t totalPins = 0;
+	int64_t totalLines = 0;
+};
@@ -0,0 +1,323 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#include "Netlist.h"
+#include <algorithm>
+
+static Index findGroupRoot(std::vector<Index>& parent, Index pin) {
+	while (parent[pin] != pin) {
+		parent[pin] = parent[parent[pin]];
+		pin = parent[pin];
+	}
+	return pin;
+}
+
+static bool isTap(PinType type) {
+	return type == PinType::CONNECTOR;
+}
+
+//roles of the pins in their group for the group tables
+enum class GroupRole : uint8_t {
+	NONE,
+	DRIVER,
+	RECEIVER,
+	TAP,
+};
+
+//fills compressed sparse rows for all grouped pins with the role, iterating in pin order keeps each group sorted
+static void buildGroupTable(const std::vector<GroupRole>& roles, const std::vector<Index>& groupByPin, Index groupCount, GroupRole role, std::vector<Index>& offsets, std::vector<Index>& groupPins) {
+	offsets.clear();
+	offsets.resize(groupCount + 1, 0);
+	for (Index i = 0; i < roles.size(); i++) {
+		if (roles[i] == role) {
+			offsets[groupByPin[i] + 1]++;
+		}
+	}
+	for (Index i = 0; i < groupCount; i++) {
+		offsets[i + 1] += offsets[i];
+	}
+
+	groupPins.clear();
+	groupPins.resize(offsets[groupCount]);
+	std::vector<Index> end(offsets.begin(), offsets.end() - 1);
+	for (Index i = 0; i < roles.size(); i++) {
+		if (roles[i] == role) {
+			groupPins[end[groupByPin[i]]++] = i;
+		}
+	}
+}
+
+//joins the pins of the lines, pins of module instances start out joined by the nets the module compiled
+//linked marks all pins with a line
+static void joinNets(std::vector<Index>& parent, std::vector<uint8_t>& linked, const std::vector<std::pair<Index, Index>>& lines,
+	const std::vector<ModuleInstance>& instances, const std::vector<Module>& modules) {
+	std::vector<Index> rank(parent.size(), 0);
+	for (Index i = 0; i < parent.size(); i++) {
+		parent[i] = i;
+	}
+	for (auto& instance : instances) {
+		auto& netRoots = modules[instance.module].netRoots;
+		for (Index i = 0; i < netRoots.size(); i++) {
+			if (netRoots[i] != -1) {
+				Index root = instance.firstPin + netRoots[i];
+				parent[instance.firstPin + i] = root;
+				rank[root] = 1;
+				linked[instance.firstPin + i] = 1;
+			}
+		}
+	}
+	for (auto& line : lines) {
+		Index a = findGroupRoot(parent, line.first);
+		Index b = findGroupRoot(parent, line.second);
+		linked[line.first] = 1;
+		linked[line.second] = 1;
+		if (a != b) {
+			if (rank[a] < rank[b]) {
+				std::swap(a, b);
+			}
+			parent[b] = a;
+			if (rank[a] == rank[b]) {
+				rank[a]++;
+			}
+		}
+	}
+}
+
+void Netlist::initGroups() {
+	std::vector<Index> parent(pins.size());
+	std::vector<uint8_t> linked(pins.size(), 0);
+	joinNets(parent, linked, lines, instances, modules);
+
+	//assign group indices in pin order to all pins that have lines
+	groupByPin.clear();
+	groupByPin.resize(pins.size(), -1);
+	std::vector<Index> groupByRoot(pins.size(), -1);
+	Index groupCount = 0;
+	for (Index pin = 0; pin < pins.size(); pin++) {
+		if (linked[pin]) {
+			Index root = findGroupRoot(parent, pin);
+			if (groupByRoot[root] == -1) {
+				groupByRoot[root] = groupCount++;
+			}
+			groupByPin[pin] = groupByRoot[root];
+		}
+	}
+
+	//compile groups, the role is looked up once per pin type
+	GroupRole roleByType[(int)PinType::PIN_TYPE_COUNT];
+	for (int i = 0; i < (int)PinType::PIN_TYPE_COUNT; i++) {
+		PinType type = (PinType)i;
+		roleByType[i] = isDriver(type) ? GroupRole::DRIVER : isReceiver(type) ? GroupRole::RECEIVER : isTap(type) ? GroupRole::TAP : GroupRole::NONE;
+	}
+	std::vector<GroupRole> roles(pins.size(), GroupRole::NONE);
+	for (Index i = 0; i < pins.size(); i++) {
+		if (groupByPin[i] != -1) {
+			roles[i] = roleByType[(int)pins[i]];
+		}
+	}
+	buildGroupTable(roles, groupByPin, groupCount, GroupRole::DRIVER, groupDriverOffsets, groupDrivers);
+	buildGroupTable(roles, groupByPin, groupCount, GroupRole::RECEIVER, groupReceiverOffsets, groupReceivers);
+	buildGroupTable(roles, groupByPin, groupCount, GroupRole::TAP, groupTapOffsets, groupTaps);
+
+	groupByDriver.clear();
+	groupByDriver.resize(pins.size(), -1);
+	for (Index i = 0; i < groupDrivers.size(); i++) {
+		groupByDriver[groupDrivers[i]] = groupByPin[groupDrivers[i]];
+	}
+	this->groupCount = groupCount;
+}
+
+void Netlist::initPinConnections() {
+	inboundPin.clear();
+	outboundPin.clear();
+	inboundPin.resize(pins.size(), -1);
+	outboundPin.resize(pins.size(), -1);
+
+	for (Index i = 0; i < pins.size(); i++) {
+		Index group = groupByPin[i];
+		if (group != -1) {
+			Index driverCount = groupDriverOffsets[group + 1] - groupDriverOffsets[group];
+			Index receiverCount = groupReceiverOffsets[group + 1] - groupReceiverOffsets[group];
+			Index tapCount = groupTapOffsets[group + 1] - groupTapOffsets[group];
+
+			if (isDriver(pins[i])) {
+				if (tapCount == 0 && receiverCount == 1) {
+					outboundPin[i] = groupReceivers[groupReceiverOffsets[group]];
+				}
+				else if (tapCount != 0 || receiverCount != 0) {
+					outboundPin[i] = -2;
+				}
+			}
+			else if (isReceiver(pins[i])) {
+				if (tapCount == 0 && driverCount == 1) {
+					inboundPin[i] = groupDrivers[groupDriverOffsets[group]];
+				}
+				else if (tapCount != 0 || driverCount != 0) {
+					inboundPin[i] = -2;
+				}
+			}
+			else if (isTap(pins[i])) {
+				inboundPin[i] = -2;
+				if (tapCount > 1 || receiverCount != 0) {
+					outboundPin[i] = -2;
+				}
+			}
+		}
+	}
+}
+
+void Netlist::initPinDescriptors() {
+	pinDescriptors.clear();
+	pinDescriptors.resize(pins.size());
+	for (Index i = 0; i < pins.size(); i++) {
+		auto& descriptor = pinDescriptors[i];
+		GateType gateType = getGateType(pins[i]);
+		descriptor.type = pins[i];
+		descriptor.baseType = getPinBaseType(pins[i]);
+		descriptor.truthTable = getTruthTable(gateType);
+		descriptor.offset = getPinOffset(pins[i]);
+	}
+	initPinDelays();
+}
+
+void Netlist::initPinDelays() {
+	for (auto& descriptor : pinDescriptors) {
+		if (descriptor.baseType == PinBaseType::INPUT) {
+			descriptor.delay = gateDelays[(int)getGateType(descriptor.type)];
+		}
+	}
+	for (auto& block : blocks) {
+		for (Index i = block.firstPin; i < block.getOutputPin(); i++) {
+			pinDescriptors[i].delay = gateDelays[(int)block.type];
+		}
+	}
+	for (auto& folded : foldedDelays) {
+		pinDescriptors[folded.pin].delay += folded.count * gateDelays[(int)folded.type];
+	}
+}
+
+void Netlist::setGateDelay(GateType type, int delay) {
+	if (gateDelays.size() <= (int)type) {
+		gateDelays.resize((int)type + 1, 1);
+	}
+	gateDelays[(int)type] = delay;
+	if (!pinDescriptors.empty()) {
+		initPinDelays();
+	}
+}
+
+const Block& Netlist::getBlock(Index pin) const {
+	auto block = std::upper_bound(blocks.begin(), blocks.end(), pin, [](Index pin, const Block& block) {
+		return pin < block.firstPin;
+	});
+	return *(block - 1);
+}
+
+int64_t Netlist::getBlockMemorySize() const {
+	return blocks.empty() ? 0 : blocks.back().memoryOffset + blocks.back().memorySize;
+}
+
+Index Netlist::addModule(const std::string& name, const Netlist& definition, const std::map<std::string, std::vector<Index>>& ports) {
+	Index existing = findModule(name);
+	if (existing != -1) {
+		return existing;
+	}
+
+	Module module;
+	module.name = name;
+	module.pins = definition.pins;
+	module.lines = definition.lines;
+	module.constantPins = definition.constantPins;
+	module.blocks = definition.blocks;
+	module.instances = definition.instances;
+	module.ports = ports;
+	module.gateCount = definition.gateCount;
+	module.lineCount = definition.getLineCount();
+	return insertModule(std::move(module), definition.modules);
+}
+
+Index Netlist::findModule(const std::string& name) const {
+	for (Index i = 0; i < modules.size(); i++) {
+		if (modules[i].name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+Index Netlist::insertModule(Module module, const std::vector<Module>& sourceModules) {
+	//nested modules are added first, so they get lower indices
+	for (auto& instance : module.instances) {
+		Index existing = findModule(sourceModules[instance.module].name);
+		if (existing != -1) {
+			instance.module = existing;
+		}
+		else {
+			instance.module = insertModule(sourceModules[instance.module], sourceModules);
+		}
+	}
+	//the nets within one instance are compiled once for all instances
+	if (module.netRoots.empty()) {
+		std::vector<Index> parent(module.pins.size());
+		std::vector<uint8_t> linked(module.pins.size(), 0);
+		joinNets(parent, linked, module.lines, module.instances, modules);
+		module.netRoots.resize(module.pins.size(), -1);
+		for (Index i = 0; i < module.pins.size(); i++) {
+			if (linked[i]) {
+				module.netRoots[i] = findGroupRoot(parent, i);
+			}
+		}
+	}
+	modules.push_back(std::move(module));
+	return modules.size() - 1;
+}
+
+int64_t Netlist::getLineCount() const {
+	int64_t count = lines.size();
+	for (auto& instance : instances) {
+		count += modules[instance.module].lineCount;
+	}
+	return count;
+}
+
+void Netlist::expandModules() {
+	std::vector<std::pair<Index, Index>> expanded;
+	expanded.reserve(getLineCount());
+	forEachLine([&](Index pinA, Index pinB) {
+		expanded.push_back({ pinA, pinB });
+	});
+	lines.swap(expanded);
+	instances.clear();
+	modules.clear();
+}
+
+std::vector<ModuleStats> Netlist::getModuleStats() const {
+	//nested modules have lower indices, so the counts can be passed down from the last module to the first
+	std::vector<int64_t> instanceCounts(modules.size(), 0);
+	for (auto& instance : instances) {
+		instanceCounts[instance.module]++;
+	}
+	for (Index i = modules.size() - 1; i >= 0; i--) {
+		for (auto& nested : modules[i].instances) {
+			instanceCounts[nested.module] += instanceCounts[i];
+		}
+	}
+
+	std::vector<ModuleStats> stats;
+	for (Index i = 0; i < modules.size(); i++) {
+		const Module& module = modules[i];
+		ModuleStats entry;
+		entry.name = module.name;
+		entry.instanceCount = instanceCounts[i];
+		entry.gates = module.gateCount;
+		entry.pins = module.pins.size();
+		entry.lines = module.lineCount;
+		entry.storedLines = module.lines.size();
+		entry.totalGates = entry.instanceCount * entry.gates;
+		entry.totalPins = entry.instanceCount * entry.pins;
+		entry.totalLines = entry.instanceCount * entry.lines;
+		stats.push_back(entry);
+	}
+	return stats;
+}
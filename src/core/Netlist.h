@@ -0,0 +1,149 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "type.h"
+#include "Block.h"
+#include "Module.h"
+#include <vector>
+#include <string>
+
+class OptimizationStats {
+public:
+	int gatesBefore = 0;
+	int gatesAfter = 0;
+	//pins that are not disabled
+	int pinsBefore = 0;
+	int pinsAfter = 0;
+	int linesBefore = 0;
+	int linesAfter = 0;
+
+	//removed gates by reason
+	int constantGates = 0;
+	int duplicateGates = 0;
+	int deadGates = 0;
+	//two input gates turned into inverters, like NAND(x, x)
+	int invertedGates = 0;
+	int rounds = 0;
+	double time = 0;
+};
+
+//delay added to a gate input pin by Netlist::optimize, count times the delay of the gate type is added to the pin
+//a gate turned into an inverter adds its old type and a negative count of NOT, so the path keeps its delay
+class FoldedDelay {
+public:
+	Index pin = 0;
+	GateType type = GateType::BUF;
+	int32_t count = 0;
+};
+
+//topology of a circuit, compiled by Circuit::prepare
+//a prepared netlist is not changed anymore and can be shared by many circuits, each with its own SimulationState
+class Netlist {
+public:
+	//circuit definition
+	std::vector<PinType> pins;
+	std::vector<std::pair<Index, Index>> lines;
+	int gateCount = 0;
+	bool prepared = false;
+	//connectors created by Pin::zero(), constant low as long as nothing drives them
+	std::vector<Index> constantPins;
+	//blocks in pin order
+	std::vector<Block> blocks;
+	//module definitions and the instances placed directly in this netlist, in pin order
+	std::vector<Module> modules;
+	std::vector<ModuleInstance> instances;
+	//scopes named by Circuit::pushScope, scopes[0] is the top level without a name
+	//each range gives the scope of the pins from its first pin on, in pin order
+	//the netlist file does not store scopes
+	std::vector<std::string> scopes;
+	std::vector<std::pair<Index, Index>> scopeRanges;
+
+	//propergation groups
+	//single source/destination per pin, -1 for none and -2 for multiple
+	std::vector<Index> inboundPin;
+	std::vector<Index> outboundPin;
+
+	//pins connected by lines form a group (a net)
+	//nets are compiled into drivers (gate outputs and inputs), receivers (gate input pins) and taps (connector pins),
+	//each stored as compressed sparse rows in ascending pin order
+	//events only go from drivers to receivers, taps follow the net value without events
+	std::vector<Index> groupByPin;
+	std::vector<Index> groupDriverOffsets;
+	std::vector<Index> groupDrivers;
+	std::vector<Index> groupReceiverOffsets;
+	std::vector<Index> groupReceivers;
+	std::vector<Index> groupTapOffsets;
+	std::vector<Index> groupTaps;
+	std::vector<Index> groupByDriver;
+	Index groupCount = 0;
+
+	std::vector<int> gateDelays;
+	//in pin order, also applied when a gate delay changes
+	std::vector<FoldedDelay> foldedDelays;
+	std::vector<PinDescriptor> pinDescriptors;
+
+	//settled state after prepare, new simulation states start from it
+	std::vector<uint8_t> initialPinStates;
+	std::vector<Index> initialGroupHighCount;
+
+	//joins the lines into nets, gates are kept as they are
+	//buffers like x.AND(x) are kept, also by optimize, removing them would make their receivers switch a gate delay earlier,
+	//so a prepared netlist always simulates with the same timing as the built circuit
+	void initGroups();
+	void initPinConnections();
+	void initPinDescriptors();
+	void setGateDelay(GateType type, int delay);
+	//block containing the pin
+	const Block& getBlock(Index pin) const;
+	int64_t getBlockMemorySize() const;
+
+	//adds a module defined by another netlist, the modules instanced there are added as well
+	//a module with the same name is only added once
+	Index addModule(const std::string& name, const Netlist& definition, const std::map<std::string, std::vector<Index>>& ports);
+	//number of lines including the lines of all module instances
+	int64_t getLineCount() const;
+	//replaces the module instances by their lines
+	void expandModules();
+	std::vector<ModuleStats> getModuleStats() const;
+
+	//calls function(pinA, pinB) for every line, including the lines of module instances
+	template<typename Function>
+	void forEachLine(Function function) const {
+		for (auto& line : lines) {
+			function(line.first, line.second);
+		}
+		for (auto& instance : instances) {
+			forEachModuleLine(instance, 0, function);
+		}
+	}
+
+	//simplifies the circuit definition before prepare (see NetlistOptimizer.cpp)
+	OptimizationStats optimize();
+
+	//binary file of a prepared netlist (see NetlistFile.cpp)
+	//loading maps the file and copies each array in one block, without building or preparing again
+	//every index the simulation uses is range checked on load, validateHash only adds the content hash check
+	bool save(const std::string& file);
+	bool load(const std::string& file, bool validateHash = true);
+
+private:
+	void initPinDelays();
+	Index findModule(const std::string& name) const;
+	//module indices of the nested instances refer to sourceModules
+	Index insertModule(Module module, const std::vector<Module>& sourceModules);
+
+	template<typename Function>
+	void forEachModuleLine(const ModuleInstance& instance, Index offset, Function& function) const {
+		const Module& module = modules[instance.module];
+		Index firstPin = offset + instance.firstPin;
+		for (auto& line : module.lines) {
+			function(firstPin + line.first, firstPin + line.second);
+		}
+		for (auto& nested : module.instances) {
+			forEachModuleLine(nested, firstPin, function);
+		}
+	}
+};
@@ -0,0 +1,407 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#include "Netlist.h"
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//file layout, all values in native byte order:
+//  header
+//  one section per array in the order of forEachArray, each section is a SectionHeader followed by the elements,
+//  padded to 8 bytes
+//the content hash covers everything after the header
+
+static const char netlistMagic[8] = { 'I', 'C', 'S', 'I', 'M', 'N', 'L', '\0' };
+static const uint32_t netlistVersion = 5;
+static const uint32_t netlistByteOrder = 0x01020304;
+
+class NetlistFileHeader {
+public:
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t fileSize;
+	uint64_t contentHash;
+	int64_t gateCount;
+	int64_t groupCount;
+	uint32_t sectionCount;
+	uint32_t reserved;
+};
+
+class NetlistSectionHeader {
+public:
+	uint64_t count;
+	uint32_t elementSize;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(NetlistFileHeader) % 8 == 0);
+static_assert(sizeof(NetlistSectionHeader) % 8 == 0);
+static_assert(std::is_trivially_copyable_v<PinDescriptor>);
+static_assert(std::is_trivially_copyable_v<FoldedDelay>);
+static_assert(std::is_trivially_copyable_v<Block>);
+
+template<typename Function>
+static void forEachArray(Netlist& netlist, Function function) {
+	function(netlist.pins);
+	function(netlist.lines);
+	function(netlist.constantPins);
+	function(netlist.blocks);
+	function(netlist.inboundPin);
+	function(netlist.outboundPin);
+	function(netlist.groupByPin);
+	function(netlist.groupDriverOffsets);
+	function(netlist.groupDrivers);
+	function(netlist.groupReceiverOffsets);
+	function(netlist.groupReceivers);
+	function(netlist.groupTapOffsets);
+	function(netlist.groupTaps);
+	function(netlist.groupByDriver);
+	function(netlist.gateDelays);
+	function(netlist.foldedDelays);
+	function(netlist.pinDescriptors);
+	function(netlist.initialPinStates);
+	function(netlist.initialGroupHighCount);
+}
+
+//FNV-1a style hash over 8 byte words, the content is always a multiple of 8 bytes
+static uint64_t hashBytes(const uint8_t* data, uint64_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (uint64_t i = 0; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		hash ^= word;
+		hash *= 1099511628211ull;
+		hash ^= hash >> 32;
+	}
+	return hash;
+}
+
+static uint64_t alignSize(uint64_t size) {
+	return (size + 7) & ~7ull;
+}
+
+bool Netlist::save(const std::string& file) {
+	if (!prepared) {
+		return false;
+	}
+	//the file has no module section, instances are stored as plain lines
+	if (!instances.empty()) {
+		Netlist expanded = *this;
+		expanded.expandModules();
+		return expanded.save(file);
+	}
+
+	std::vector<uint8_t> content;
+	uint32_t sectionCount = 0;
+	forEachArray(*this, [&](auto& array) {
+		using Element = typename std::remove_reference_t<decltype(array)>::value_type;
+		NetlistSectionHeader section = {};
+		section.count = array.size();
+		section.elementSize = sizeof(Element);
+		uint64_t offset = content.size();
+		content.resize(offset + sizeof(section) + alignSize(array.size() * sizeof(Element)), 0);
+		memcpy(content.data() + offset, &section, sizeof(section));
+		if (!array.empty()) {
+			memcpy(content.data() + offset + sizeof(section), array.data(), array.size() * sizeof(Element));
+		}
+		sectionCount++;
+	});
+
+	NetlistFileHeader header = {};
+	memcpy(header.magic, netlistMagic, sizeof(header.magic));
+	header.version = netlistVersion;
+	header.byteOrder = netlistByteOrder;
+	header.fileSize = sizeof(header) + content.size();
+	header.contentHash = hashBytes(content.data(), content.size());
+	header.gateCount = gateCount;
+	header.groupCount = groupCount;
+	header.sectionCount = sectionCount;
+
+	std::ofstream stream(file, std::ios::binary);
+	if (!stream) {
+		return false;
+	}
+	stream.write((const char*)&header, sizeof(header));
+	stream.write((const char*)content.data(), content.size());
+	return (bool)stream;
+}
+
+//read only view of a whole file, mapped where possible
+class MappedFile {
+public:
+	const uint8_t* data = nullptr;
+	uint64_t size = 0;
+
+	bool open(const std::string& file) {
+#ifdef _WIN32
+		std::ifstream stream(file, std::ios::binary | std::ios::ate);
+		if (!stream) {
+			return false;
+		}
+		buffer.resize(stream.tellg());
+		stream.seekg(0);
+		stream.read((char*)buffer.data(), buffer.size());
+		data = buffer.data();
+		size = buffer.size();
+		return (bool)stream;
+#else
+		int descriptor = ::open(file.c_str(), O_RDONLY);
+		if (descriptor == -1) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+			::close(descriptor);
+			return false;
+		}
+		void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		::close(descriptor);
+		if (mapping == MAP_FAILED) {
+			return false;
+		}
+		data = (const uint8_t*)mapping;
+		size = info.st_size;
+		return true;
+#endif
+	}
+
+	~MappedFile() {
+#ifndef _WIN32
+		if (data) {
+			munmap((void*)data, size);
+		}
+#endif
+	}
+
+private:
+#ifdef _WIN32
+	std::vector<uint8_t> buffer;
+#endif
+};
+
+static bool isPinInRange(Index pin, Index pinCount) {
+	return pin >= 0 && pin < pinCount;
+}
+
+//the offsets have to start at 0, ascend and end at the entry count, every entry has to be a pin of its group
+static bool isValidGroupTable(const std::vector<Index>& offsets, const std::vector<Index>& entries, const std::vector<Index>& groupByPin) {
+	if (offsets.front() != 0 || offsets.back() != entries.size()) {
+		return false;
+	}
+	for (Index group = 0; group + 1 < offsets.size(); group++) {
+		if (offsets[group] > offsets[group + 1]) {
+			return false;
+		}
+		for (Index i = offsets[group]; i < offsets[group + 1]; i++) {
+			if (!isPinInRange(entries[i], groupByPin.size()) || groupByPin[entries[i]] != group) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//pin counts and memory size as created by Circuit::addRam and Circuit::addBlock
+static bool isValidBlock(const Block& block, Index pinCount) {
+	if (block.firstPin < 0 || block.inputCount < 1 || block.outputCount < 1 || block.inputCount > pinCount || block.outputCount > pinCount) {
+		return false;
+	}
+	if ((int64_t)block.firstPin + block.inputCount + block.outputCount > pinCount) {
+		return false;
+	}
+	if (block.dataSize < 0 || block.addressSize < 0 || block.wordCount < 0 || block.wordCount > INT64_MAX / std::max(block.getWordBytes(), 1)) {
+		return false;
+	}
+	if (block.memorySize != block.wordCount * block.getWordBytes()) {
+		return false;
+	}
+	switch (block.type) {
+	case GateType::RAM:
+		return block.addressSize < 63 && block.inputCount == block.addressSize + block.dataSize + 3 && block.outputCount == block.dataSize;
+	case GateType::WORD_ADD:
+		return block.inputCount == block.dataSize * 2 + 1 && block.outputCount == block.dataSize + 1;
+	case GateType::WORD_LATCH:
+	case GateType::WORD_AND:
+		return block.inputCount == block.dataSize + 1 && block.outputCount == block.dataSize;
+	case GateType::WORD_DECODER:
+		return block.addressSize < 31 && block.inputCount == block.addressSize && block.outputCount == (Index)1 << block.addressSize;
+	default:
+		return false;
+	}
+}
+
+bool Netlist::load(const std::string& file, bool validateHash) {
+	MappedFile mapped;
+	if (!mapped.open(file) || mapped.size < sizeof(NetlistFileHeader)) {
+		return false;
+	}
+
+	NetlistFileHeader header;
+	memcpy(&header, mapped.data, sizeof(header));
+	if (memcmp(header.magic, netlistMagic, sizeof(header.magic)) != 0 || header.version != netlistVersion) {
+		return false;
+	}
+	if (header.byteOrder != netlistByteOrder || header.fileSize != mapped.size) {
+		return false;
+	}
+	const uint8_t* content = mapped.data + sizeof(header);
+	uint64_t contentSize = mapped.size - sizeof(header);
+	if (validateHash && hashBytes(content, contentSize) != header.contentHash) {
+		return false;
+	}
+
+	Netlist netlist;
+	uint64_t offset = 0;
+	uint32_t sectionCount = 0;
+	bool valid = true;
+	forEachArray(netlist, [&](auto& array) {
+		using Element = typename std::remove_reference_t<decltype(array)>::value_type;
+		NetlistSectionHeader section;
+		if (!valid || offset + sizeof(section) > contentSize) {
+			valid = false;
+			return;
+		}
+		memcpy(&section, content + offset, sizeof(section));
+		offset += sizeof(section);
+		uint64_t bytes = section.count * sizeof(Element);
+		if (section.elementSize != sizeof(Element) || section.count > contentSize || offset + alignSize(bytes) > contentSize) {
+			valid = false;
+			return;
+		}
+		//sections are 8 byte aligned in the mapping, so the elements can be copied directly
+		const Element* elements = (const Element*)(content + offset);
+		array.assign(elements, elements + section.count);
+		offset += alignSize(bytes);
+		sectionCount++;
+	});
+	if (!valid || sectionCount != header.sectionCount || offset != contentSize) {
+		return false;
+	}
+
+	//sizes the simulation relies on
+	Index pinCount = netlist.pins.size();
+	if (header.groupCount < 0 || header.groupCount > pinCount || header.gateCount < 0) {
+		return false;
+	}
+	Index groupCount = header.groupCount;
+	for (auto* array : { &netlist.inboundPin, &netlist.outboundPin, &netlist.groupByPin, &netlist.groupByDriver }) {
+		if (array->size() != pinCount) {
+			return false;
+		}
+	}
+	for (auto* array : { &netlist.groupDriverOffsets, &netlist.groupReceiverOffsets, &netlist.groupTapOffsets }) {
+		if (array->size() != groupCount + 1) {
+			return false;
+		}
+	}
+	if (netlist.pinDescriptors.size() != pinCount || netlist.initialPinStates.size() != pinCount) {
+		return false;
+	}
+	if (netlist.initialGroupHighCount.size() != groupCount || netlist.gateDelays.size() < (int)GateType::GATE_TYPE_COUNT) {
+		return false;
+	}
+
+	//contents the simulation indexes with, the hash only detects damaged files, not files written by something else
+	for (int delay : netlist.gateDelays) {
+		if (delay < 0) {
+			return false;
+		}
+	}
+	for (Index pin = 0; pin < pinCount; pin++) {
+		PinType type = netlist.pins[pin];
+		if ((int)type >= (int)PinType::PIN_TYPE_COUNT) {
+			return false;
+		}
+		//the descriptors are derived from the pin types, only the delays can differ
+		const PinDescriptor& descriptor = netlist.pinDescriptors[pin];
+		if (descriptor.type != type || descriptor.baseType != getPinBaseType(type) || descriptor.offset != getPinOffset(type)) {
+			return false;
+		}
+		if (descriptor.truthTable != getTruthTable(getGateType(type)) || descriptor.delay < 0 || !isPinInRange(pin + descriptor.offset, pinCount)) {
+			return false;
+		}
+		if (getGateType(netlist.pins[pin + descriptor.offset]) != getGateType(type)) {
+			return false;
+		}
+		if (netlist.initialPinStates[pin] > 1) {
+			return false;
+		}
+		Index group = netlist.groupByPin[pin];
+		Index driverGroup = netlist.groupByDriver[pin];
+		if (group < -1 || group >= groupCount || (driverGroup != -1 && driverGroup != group)) {
+			return false;
+		}
+		for (Index connection : { netlist.inboundPin[pin], netlist.outboundPin[pin] }) {
+			if (connection < -2 || connection >= pinCount) {
+				return false;
+			}
+		}
+	}
+	if (!isValidGroupTable(netlist.groupDriverOffsets, netlist.groupDrivers, netlist.groupByPin)) {
+		return false;
+	}
+	if (!isValidGroupTable(netlist.groupReceiverOffsets, netlist.groupReceivers, netlist.groupByPin)) {
+		return false;
+	}
+	if (!isValidGroupTable(netlist.groupTapOffsets, netlist.groupTaps, netlist.groupByPin)) {
+		return false;
+	}
+	for (Index group = 0; group < groupCount; group++) {
+		Index driverCount = netlist.groupDriverOffsets[group + 1] - netlist.groupDriverOffsets[group];
+		if (netlist.initialGroupHighCount[group] < 0 || netlist.initialGroupHighCount[group] > driverCount) {
+			return false;
+		}
+	}
+	for (auto& line : netlist.lines) {
+		if (!isPinInRange(line.first, pinCount) || !isPinInRange(line.second, pinCount)) {
+			return false;
+		}
+	}
+	for (auto& folded : netlist.foldedDelays) {
+		if (!isPinInRange(folded.pin, pinCount) || (int)folded.type >= (int)GateType::GATE_TYPE_COUNT) {
+			return false;
+		}
+	}
+	for (Index pin : netlist.constantPins) {
+		if (!isPinInRange(pin, pinCount)) {
+			return false;
+		}
+	}
+	int64_t memoryOffset = 0;
+	Index blockEnd = 0;
+	Index blockPinCount = 0;
+	for (auto& block : netlist.blocks) {
+		if (!isValidBlock(block, pinCount) || block.firstPin < blockEnd || block.memoryOffset != memoryOffset) {
+			return false;
+		}
+		for (Index pin = block.firstPin; pin < block.getEndPin(); pin++) {
+			if (netlist.pins[pin] != (pin < block.getOutputPin() ? PinType::BLOCK_IN : PinType::BLOCK_OUT)) {
+				return false;
+			}
+		}
+		memoryOffset += block.memorySize;
+		blockEnd = block.getEndPin();
+		blockPinCount += block.inputCount + block.outputCount;
+	}
+	//block pins outside of a block
+	if (std::count(netlist.pins.begin(), netlist.pins.end(), PinType::BLOCK_IN) + std::count(netlist.pins.begin(), netlist.pins.end(), PinType::BLOCK_OUT) != blockPinCount) {
+		return false;
+	}
+
+	netlist.gateCount = header.gateCount;
+	netlist.groupCount = groupCount;
+	netlist.prepared = true;
+	*this = std::move(netlist);
+	return true;
+}
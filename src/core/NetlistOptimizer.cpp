@@ -0,0 +1,529 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#include "Netlist.h"
+#include "util/Clock.h"
+#include <unordered_map>
+#include <array>
+
+//the optimizer works on nets and on classes of nets that are known to carry the same settled value
+//a gate is removed when its output net is driven by the gate alone, has no connector and is equal to another class:
+//  constant folding:   inputs from Pin::zero()/one(), like AND(x, 0) or OR(x, 1)
+//  duplicates:         gates of the same type with the same input classes and input delays
+//the removed gate output becomes a connector on the net it is equal to, its input pins are disabled
+//afterwards all gates that have no path to a connector or block are removed as dead logic
+//
+//pin indices stay the same, so pins and buses created before keep working
+//only gates that do not change the timing are removed, a constant never changes and a duplicate switches with the gate it is joined to
+//buffers like BUF(x), AND(x, 1) or XOR(x, 0) and inverter pairs stay, without them the receivers would switch a gate delay earlier
+//NAND(x, x), NOR(x, 0) and XOR(x, 1) become inverters that keep the delay of their old type (see FoldedDelay)
+//the connector of a removed gate is read like the gate output, setting it from outside sets the net it was joined to,
+//a connector placed on a gate output before optimizing keeps the gate
+
+static Index findRoot(std::vector<Index>& parent, Index index) {
+	while (parent[index] != index) {
+		parent[index] = parent[parent[index]];
+		index = parent[index];
+	}
+	return index;
+}
+
+static void unite(std::vector<Index>& parent, Index a, Index b) {
+	a = findRoot(parent, a);
+	b = findRoot(parent, b);
+	if (a != b) {
+		parent[b] = a;
+	}
+}
+
+//delay of a path as the number of gates of each type, so it stays right when a gate delay is changed later
+typedef std::array<int32_t, (int)GateType::GATE_TYPE_COUNT> PathDelay;
+
+static int getInputCount(GateType type) {
+	return type == GateType::BUF || type == GateType::NOT ? 1 : 2;
+}
+
+static bool isCommutative(GateType type) {
+	return type != GateType::D_LATCH;
+}
+
+class OptimizerGate {
+public:
+	Index out = -1;
+	GateType type = GateType::CONNECTOR;
+	//input pins, the same pin for single input gates
+	Index a = -1;
+	Index b = -1;
+	bool removed = false;
+	bool inverted = false;
+	//type before it was turned into an inverter
+	GateType originalType = GateType::CONNECTOR;
+};
+
+OptimizationStats Netlist::optimize() {
+	Clock clock;
+	OptimizationStats stats;
+	expandModules();
+	Index pinCount = pins.size();
+	auto countPins = [&]() {
+		int count = 0;
+		for (PinType type : pins) {
+			count += type != PinType::DISABLED;
+		}
+		return count;
+	};
+	stats.gatesBefore = gateCount;
+	stats.pinsBefore = countPins();
+	stats.linesBefore = lines.size();
+
+	//nets of the unoptimized circuit, pins without lines are nets of their own
+	std::vector<Index> parent(pinCount);
+	for (Index i = 0; i < pinCount; i++) {
+		parent[i] = i;
+	}
+	for (auto& line : lines) {
+		unite(parent, line.first, line.second);
+	}
+	std::vector<Index> netByPin(pinCount);
+	std::vector<Index> netByRoot(pinCount, -1);
+	Index netCount = 0;
+	for (Index i = 0; i < pinCount; i++) {
+		Index root = findRoot(parent, i);
+		if (netByRoot[root] == -1) {
+			netByRoot[root] = netCount++;
+		}
+		netByPin[i] = netByRoot[root];
+	}
+
+	std::vector<Index> driverCount(netCount, 0);
+	std::vector<uint8_t> observable(netCount, 0);
+	std::vector<uint8_t> hasConnector(netCount, 0);
+	std::vector<OptimizerGate> gates;
+	for (Index i = 0; i < pinCount; i++) {
+		PinBaseType baseType = getPinBaseType(pins[i]);
+		if (isDriver(pins[i])) {
+			driverCount[netByPin[i]]++;
+		}
+		if (pins[i] == PinType::CONNECTOR || baseType == PinBaseType::BLOCK_INPUT) {
+			observable[netByPin[i]] = 1;
+		}
+		if (pins[i] == PinType::CONNECTOR) {
+			hasConnector[netByPin[i]] = 1;
+		}
+		if (baseType == PinBaseType::OUTPUT) {
+			OptimizerGate gate;
+			gate.out = i;
+			gate.type = getGateType(pins[i]);
+			gate.originalType = gate.type;
+			gate.a = i + getPinOffset(pins[i]);
+			gate.b = i - 1;
+			gates.push_back(gate);
+		}
+	}
+	auto isSoleDriver = [&](OptimizerGate& gate) {
+		return driverCount[netByPin[gate.out]] == 1;
+	};
+	//a connector on the output would be joined to another net, setting it from outside would then also set that net
+	auto isRemovable = [&](OptimizerGate& gate) {
+		return isSoleDriver(gate) && !hasConnector[netByPin[gate.out]];
+	};
+
+	//classes of nets with the same value, -1 for unknown, 0 or 1 for constants
+	std::vector<Index> classParent(netCount);
+	std::vector<int8_t> classConstant(netCount, -1);
+	for (Index i = 0; i < netCount; i++) {
+		classParent[i] = i;
+	}
+	auto classOf = [&](Index pin) {
+		return findRoot(classParent, netByPin[pin]);
+	};
+	Index zeroClass = -1;
+	Index oneClass = -1;
+	for (Index pin : constantPins) {
+		Index net = netByPin[pin];
+		if (driverCount[net] == 0) {
+			if (zeroClass == -1) {
+				zeroClass = net;
+				classConstant[net] = 0;
+			}
+			unite(classParent, zeroClass, net);
+		}
+	}
+	auto joinClass = [&](Index a, Index b) {
+		int8_t constant = std::max(classConstant[findRoot(classParent, a)], classConstant[findRoot(classParent, b)]);
+		unite(classParent, a, b);
+		classConstant[findRoot(classParent, a)] = constant;
+		if (zeroClass != -1) {
+			zeroClass = findRoot(classParent, zeroClass);
+		}
+		if (oneClass != -1) {
+			oneClass = findRoot(classParent, oneClass);
+		}
+	};
+
+	//folded delays of earlier runs are kept
+	std::unordered_map<Index, std::vector<FoldedDelay>> previousFolds;
+	for (auto& folded : foldedDelays) {
+		previousFolds[folded.pin].push_back(folded);
+	}
+	//delay folded into an input pin of a gate, an inverter switches with the delay of its old type
+	auto getInputDelay = [&](const OptimizerGate& gate, Index pin) {
+		PathDelay delay = {};
+		if (gate.inverted) {
+			delay[(int)gate.originalType]++;
+			delay[(int)GateType::NOT]--;
+		}
+		auto entry = previousFolds.find(pin);
+		if (entry != previousFolds.end()) {
+			for (auto& folded : entry->second) {
+				delay[(int)folded.type] += folded.count;
+			}
+		}
+		return delay;
+	};
+
+	//duplicates are only removed when the receivers see the same timing from the kept gate
+	auto hasSameInputDelays = [&](const OptimizerGate& gate, const OptimizerGate& kept) {
+		bool swapped = classOf(gate.a) != classOf(kept.a);
+		return getInputDelay(gate, gate.a) == getInputDelay(kept, swapped ? kept.b : kept.a)
+			&& getInputDelay(gate, gate.b) == getInputDelay(kept, swapped ? kept.a : kept.b);
+	};
+
+	std::unordered_map<uint64_t, Index> gateByInputs;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		stats.rounds++;
+		gateByInputs.clear();
+
+		for (Index g = 0; g < gates.size(); g++) {
+			auto& gate = gates[g];
+			if (gate.removed) {
+				continue;
+			}
+			Index a = classOf(gate.a);
+			Index b = classOf(gate.b);
+			int8_t valueA = classConstant[a];
+			int8_t valueB = classConstant[b];
+
+			//the value of the gate output as a class, a constant or the inverse of an input pin
+			Index result = -1;
+			int8_t constant = -1;
+			Index invert = -1;
+			int* reason = &stats.constantGates;
+
+			switch (gate.type) {
+			case GateType::BUF:
+				result = a;
+				break;
+			case GateType::NOT:
+				if (valueA != -1) {
+					constant = !valueA;
+				}
+				break;
+			case GateType::AND:
+			case GateType::NAND:
+				if (valueA == 0 || valueB == 0) {
+					constant = 0;
+				}
+				else if (a == b || valueB == 1) {
+					result = a;
+				}
+				else if (valueA == 1) {
+					result = b;
+				}
+				if (gate.type == GateType::NAND) {
+					constant = constant == -1 ? -1 : !constant;
+					invert = result == -1 ? -1 : (result == a ? gate.a : gate.b);
+					result = -1;
+				}
+				break;
+			case GateType::OR:
+			case GateType::NOR:
+				if (valueA == 1 || valueB == 1) {
+					constant = 1;
+				}
+				else if (a == b || valueB == 0) {
+					result = a;
+				}
+				else if (valueA == 0) {
+					result = b;
+				}
+				if (gate.type == GateType::NOR) {
+					constant = constant == -1 ? -1 : !constant;
+					invert = result == -1 ? -1 : (result == a ? gate.a : gate.b);
+					result = -1;
+				}
+				break;
+			case GateType::XOR:
+				if (a == b || (valueA != -1 && valueB != -1)) {
+					constant = a == b ? 0 : valueA ^ valueB;
+				}
+				else if (valueB == 0) {
+					result = a;
+				}
+				else if (valueA == 0) {
+					result = b;
+				}
+				else if (valueB == 1) {
+					invert = gate.a;
+				}
+				else if (valueA == 1) {
+					invert = gate.b;
+				}
+				break;
+			case GateType::D_LATCH:
+				//a latch that is never enabled keeps its initial low state
+				if (valueB == 0) {
+					constant = 0;
+				}
+				else if (valueB == 1) {
+					result = a;
+				}
+				break;
+			default:
+				break;
+			}
+			//a buffer stays, its receivers would switch a gate delay earlier without it
+			if (constant == -1 && result != -1) {
+				continue;
+			}
+			//both inputs carry the same value, but the inverter keeps only one of the paths
+			if (a == b && invert != -1 && getInputDelay(gate, gate.a) != getInputDelay(gate, gate.b)) {
+				continue;
+			}
+
+			if (constant != -1) {
+				if (constant == 1 && oneClass == -1) {
+					//the first constant high gate stays and provides the constant for all others
+					oneClass = classOf(gate.out);
+					classConstant[oneClass] = 1;
+					changed = true;
+					continue;
+				}
+				if (constant == 0 && zeroClass == -1) {
+					if (!isSoleDriver(gate)) {
+						continue;
+					}
+					//without a constant net, the output net of the removed gate is left without a driver
+					zeroClass = classOf(gate.out);
+					classConstant[zeroClass] = 0;
+				}
+				result = constant ? oneClass : zeroClass;
+			}
+			else if (invert != -1) {
+				gate.type = GateType::NOT;
+				gate.a = invert;
+				gate.b = invert;
+				gate.inverted = true;
+				stats.invertedGates++;
+				changed = true;
+				continue;
+			}
+			else if (result == -1 && isSoleDriver(gate)) {
+				//structural hashing, inputs of commutative gates are ordered
+				Index first = isCommutative(gate.type) ? std::min(a, b) : a;
+				Index second = isCommutative(gate.type) ? std::max(a, b) : b;
+				uint64_t key = (((uint64_t)first * netCount) + second) * (uint64_t)GateType::GATE_TYPE_COUNT + (uint64_t)gate.type;
+				auto entry = gateByInputs.find(key);
+				if (entry == gateByInputs.end()) {
+					gateByInputs[key] = g;
+				}
+				else if (!hasSameInputDelays(gate, gates[entry->second])) {
+					continue;
+				}
+				else {
+					result = classOf(gates[entry->second].out);
+					reason = &stats.duplicateGates;
+				}
+			}
+
+			if (result == -1 || !isRemovable(gate)) {
+				continue;
+			}
+			Index own = classOf(gate.out);
+			if (own == result) {
+				if (constant == 0 && own == zeroClass) {
+					gate.removed = true;
+					(*reason)++;
+					changed = true;
+				}
+				continue;
+			}
+			gate.removed = true;
+			(*reason)++;
+			joinClass(result, own);
+			changed = true;
+		}
+	}
+
+	//every class is represented by a net that keeps its driver, removed gate outputs join that net
+	std::vector<uint8_t> removedOutput(netCount, 0);
+	for (auto& gate : gates) {
+		if (gate.removed) {
+			removedOutput[netByPin[gate.out]] = 1;
+		}
+	}
+	std::vector<Index> representative(netCount, -1);
+	for (Index net = 0; net < netCount; net++) {
+		Index root = findRoot(classParent, net);
+		if (representative[root] == -1 || (removedOutput[representative[root]] && !removedOutput[net])) {
+			representative[root] = net;
+		}
+	}
+	//classes made only of removed gates keep one gate, constant low classes need no driver
+	for (auto& gate : gates) {
+		Index net = netByPin[gate.out];
+		Index root = findRoot(classParent, net);
+		if (gate.removed && representative[root] == net && classConstant[root] != 0) {
+			gate.removed = false;
+			removedOutput[net] = 0;
+		}
+	}
+
+	std::vector<Index> finalNet(netCount);
+	for (Index net = 0; net < netCount; net++) {
+		finalNet[net] = net;
+	}
+	for (auto& gate : gates) {
+		if (gate.removed) {
+			unite(finalNet, representative[findRoot(classParent, netByPin[gate.out])], netByPin[gate.out]);
+		}
+	}
+	//input pin of an inverted gate, the remaining input moves into the net of the original pin
+	auto getInputNet = [&](OptimizerGate& gate) {
+		return findRoot(finalNet, netByPin[gate.a]);
+	};
+
+	//dead logic, a gate is live when its output reaches a connector or block
+	std::vector<uint8_t> liveNet(netCount, 0);
+	std::vector<Index> pending;
+	for (Index net = 0; net < netCount; net++) {
+		Index root = findRoot(finalNet, net);
+		if (observable[net] && !liveNet[root]) {
+			liveNet[root] = 1;
+			pending.push_back(root);
+		}
+	}
+	std::vector<Index> gateOffsets(netCount + 1, 0);
+	std::vector<Index> gatesByNet;
+	for (auto& gate : gates) {
+		if (!gate.removed) {
+			gateOffsets[findRoot(finalNet, netByPin[gate.out]) + 1]++;
+		}
+	}
+	for (Index net = 0; net < netCount; net++) {
+		gateOffsets[net + 1] += gateOffsets[net];
+	}
+	gatesByNet.resize(gateOffsets[netCount]);
+	std::vector<Index> end(gateOffsets.begin(), gateOffsets.end() - 1);
+	for (Index g = 0; g < gates.size(); g++) {
+		if (!gates[g].removed) {
+			gatesByNet[end[findRoot(finalNet, netByPin[gates[g].out])]++] = g;
+		}
+	}
+	std::vector<uint8_t> liveGate(gates.size(), 0);
+	while (!pending.empty()) {
+		Index net = pending.back();
+		pending.pop_back();
+		for (Index i = gateOffsets[net]; i < gateOffsets[net + 1]; i++) {
+			Index g = gatesByNet[i];
+			liveGate[g] = 1;
+			auto& gate = gates[g];
+			for (Index input : { getInputNet(gate), findRoot(finalNet, netByPin[gate.b]) }) {
+				if (!liveNet[input]) {
+					liveNet[input] = 1;
+					pending.push_back(input);
+				}
+			}
+		}
+	}
+
+	//rewrite the pins, removed and dead pins are disabled and leave their nets
+	std::vector<Index> netOfPin(pinCount);
+	for (Index i = 0; i < pinCount; i++) {
+		netOfPin[i] = findRoot(finalNet, netByPin[i]);
+	}
+	std::vector<uint8_t> disabled(pinCount, 0);
+	for (Index g = 0; g < gates.size(); g++) {
+		auto& gate = gates[g];
+		Index first = gate.out - getInputCount(getGateType(pins[gate.out]));
+		if (gate.removed || !liveGate[g]) {
+			for (Index pin = first; pin < gate.out; pin++) {
+				pins[pin] = PinType::DISABLED;
+				disabled[pin] = 1;
+			}
+			if (gate.removed) {
+				pins[gate.out] = PinType::CONNECTOR;
+			}
+			else {
+				pins[gate.out] = PinType::DISABLED;
+				disabled[gate.out] = 1;
+				stats.deadGates++;
+			}
+			gateCount--;
+		}
+		else if (gate.inverted) {
+			Index net = getInputNet(gate);
+			for (Index pin = first; pin < gate.out - 1; pin++) {
+				pins[pin] = PinType::DISABLED;
+				disabled[pin] = 1;
+			}
+			pins[gate.out - 1] = PinType::NOT_IN;
+			pins[gate.out] = PinType::NOT_OUT;
+			netOfPin[gate.out - 1] = net;
+		}
+	}
+
+	//inverters keep the delay of their old type
+	std::vector<Index> inputGate(pinCount, -1);
+	for (Index g = 0; g < gates.size(); g++) {
+		if (!gates[g].removed && liveGate[g]) {
+			for (Index pin = gates[g].out - getInputCount(getGateType(pins[gates[g].out])); pin < gates[g].out; pin++) {
+				inputGate[pin] = g;
+			}
+		}
+	}
+	std::vector<FoldedDelay> folds;
+	for (Index i = 0; i < pinCount; i++) {
+		if (disabled[i] || !isReceiver(pins[i])) {
+			continue;
+		}
+		Index g = inputGate[i];
+		PathDelay delay;
+		if (g != -1 && gates[g].inverted) {
+			delay = getInputDelay(gates[g], gates[g].a);
+		}
+		else {
+			delay = getInputDelay(OptimizerGate(), i);
+		}
+		for (int type = 0; type < (int)GateType::GATE_TYPE_COUNT; type++) {
+			if (delay[type] != 0) {
+				folds.push_back({ i, (GateType)type, delay[type] });
+			}
+		}
+	}
+	foldedDelays = std::move(folds);
+
+	//each net becomes a chain of lines in pin order
+	lines.clear();
+	std::vector<Index> lastPin(netCount, -1);
+	for (Index i = 0; i < pinCount; i++) {
+		if (disabled[i]) {
+			continue;
+		}
+		Index net = netOfPin[i];
+		if (lastPin[net] != -1) {
+			lines.push_back({ lastPin[net], i });
+		}
+		lastPin[net] = i;
+	}
+
+	prepared = false;
+	stats.gatesAfter = gateCount;
+	stats.pinsAfter = countPins();
+	stats.linesAfter = lines.size();
+	stats.time = clock.elapsed();
+	return stats;
+}
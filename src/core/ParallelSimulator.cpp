@@ -0,0 +1,401 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#include "ParallelSimulator.h"
+#include "Circuit.h"
+#include <algorithm>
+#include <climits>
+
+ParallelSimulator::~ParallelSimulator() {
+	stopThreads();
+}
+
+void ParallelSimulator::build(Circuit* circuit, int threadCount) {
+	stopThreads();
+	this->circuit = circuit;
+	auto& netlist = *circuit->netlist;
+	auto& pins = netlist.pins;
+	Index pinCount = pins.size();
+	Index groupCount = netlist.groupCount;
+	threadCount = std::clamp(threadCount, 1, std::max(1, std::min(pinCount, (Index)UINT16_MAX)));
+
+	//split the pins into ranges of equal size without splitting a gate or block
+	auto isInside = [&](Index end) {
+		PinBaseType before = getPinBaseType(pins[end - 1]);
+		PinBaseType after = getPinBaseType(pins[end]);
+		return before == PinBaseType::INPUT || before == PinBaseType::BLOCK_INPUT || (before == PinBaseType::BLOCK_OUTPUT && after == PinBaseType::BLOCK_OUTPUT);
+	};
+	partitions.clear();
+	partitions.resize(threadCount);
+	partitionByPin.resize(pinCount);
+	Index begin = 0;
+	for (int p = 0; p < threadCount; p++) {
+		Index end = p == threadCount - 1 ? pinCount : (Index)((int64_t)pinCount * (p + 1) / threadCount);
+		end = std::max(end, begin);
+		while (end > 0 && end < pinCount && isInside(end)) {
+			end++;
+		}
+
+		auto& partition = partitions[p];
+		partition.beginPin = begin;
+		partition.endPin = end;
+		partition.queue.sortQueue = true;
+		partition.queue.useUpdateSet = circuit->state.queue.useUpdateSet;
+		partition.queue.resize(end - begin, begin);
+		partition.groupChanges.resize(threadCount);
+		partition.receivers.resize(threadCount);
+		for (Index i = begin; i < end; i++) {
+			partitionByPin[i] = p;
+		}
+		begin = end;
+	}
+
+	//a net is owned by the partition of its first driver
+	partitionByGroup.resize(groupCount);
+	for (Index group = 0; group < groupCount; group++) {
+		if (netlist.groupDriverOffsets[group] != netlist.groupDriverOffsets[group + 1]) {
+			partitionByGroup[group] = partitionByPin[netlist.groupDrivers[netlist.groupDriverOffsets[group]]];
+		}
+		else if (netlist.groupReceiverOffsets[group] != netlist.groupReceiverOffsets[group + 1]) {
+			partitionByGroup[group] = partitionByPin[netlist.groupReceivers[netlist.groupReceiverOffsets[group]]];
+		}
+		else {
+			partitionByGroup[group] = partitionByPin[netlist.groupTaps[netlist.groupTapOffsets[group]]];
+		}
+	}
+	groupTouched.assign(groupCount, 0);
+
+	if (threadCount > 1) {
+		startThreads();
+	}
+}
+
+int ParallelSimulator::getThreadCount() {
+	return partitions.size();
+}
+
+int ParallelSimulator::getLookahead() {
+	int lookahead = INT_MAX;
+	for (int type = (int)GateType::BUF; type < (int)GateType::GATE_TYPE_COUNT; type++) {
+		lookahead = std::min(lookahead, circuit->netlist->gateDelays[type]);
+	}
+	return lookahead;
+}
+
+int ParallelSimulator::simulate(int timeUnits, bool fillTime) {
+	int64_t startTime = circuit->state.simulationTime;
+	endTime = timeUnits == -1 ? -1 : startTime + timeUnits;
+
+	for (auto& partition : partitions) {
+		if (partition.queue.useUpdateSet != circuit->state.queue.useUpdateSet) {
+			partition.queue.useUpdateSet = circuit->state.queue.useUpdateSet;
+			std::fill(partition.queue.pendingPins.begin(), partition.queue.pendingPins.end(), 0);
+		}
+	}
+
+	//external events are processed in order on the calling thread, like the sequential engine does
+	externalPins.clear();
+	for (Index pin : circuit->state.changedPins) {
+		auto& queue = partitions[partitionByPin[pin]].queue;
+		if (queue.useUpdateSet) {
+			if (queue.pendingPins[pin - queue.pinOffset]) {
+				queue.skippedCount++;
+				continue;
+			}
+			queue.pendingPins[pin - queue.pinOffset] = 1;
+		}
+		queue.addedCount++;
+		externalPins.push_back(pin);
+	}
+	circuit->state.changedPins.clear();
+	for (Index pin : externalPins) {
+		auto& queue = partitions[partitionByPin[pin]].queue;
+		if (queue.useUpdateSet) {
+			queue.pendingPins[pin - queue.pinOffset] = 0;
+		}
+		processExternal(pin, startTime);
+	}
+	circuit->stats.events += externalPins.size();
+	circuit->stats.externalEvents += externalPins.size();
+
+	lastTime = startTime;
+	for (auto& partition : partitions) {
+		partition.nextTime = partition.queue.empty() ? INT64_MAX : partition.queue.get().time;
+	}
+	if (barrier) {
+		barrier->arrive_and_wait();
+		run(0);
+		barrier->arrive_and_wait();
+	}
+	else {
+		run(0);
+	}
+
+	for (auto& partition : partitions) {
+		circuit->state.queue.addedCount += partition.queue.addedCount;
+		circuit->state.queue.skippedCount += partition.queue.skippedCount;
+		partition.queue.addedCount = 0;
+		partition.queue.skippedCount = 0;
+		circuit->stats.add(partition.stats);
+		partition.stats = SimulationStats();
+	}
+
+	circuit->state.simulationTime = lastTime;
+	int timeNeeded = lastTime - startTime;
+	if (endTime != -1 && circuit->state.simulationTime < endTime && (fillTime || hasEvents())) {
+		circuit->state.simulationTime = endTime;
+	}
+	return timeNeeded;
+}
+
+bool ParallelSimulator::hasEvents() {
+	for (auto& partition : partitions) {
+		if (!partition.queue.empty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void ParallelSimulator::startThreads() {
+	barrier = std::make_unique<std::barrier<>>(partitions.size());
+	for (Index p = 1; p < partitions.size(); p++) {
+		threads.emplace_back([this, p]() {
+			while (true) {
+				barrier->arrive_and_wait();
+				if (stopping) {
+					return;
+				}
+				run(p);
+				barrier->arrive_and_wait();
+			}
+		});
+	}
+}
+
+void ParallelSimulator::stopThreads() {
+	if (threads.empty()) {
+		return;
+	}
+	stopping = true;
+	barrier->arrive_and_wait();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+	barrier.reset();
+	stopping = false;
+}
+
+void ParallelSimulator::sync() {
+	if (barrier) {
+		barrier->arrive_and_wait();
+	}
+}
+
+void ParallelSimulator::run(Index p) {
+	auto& partition = partitions[p];
+	while (true) {
+		//every partition computes the same next step from the posted event times
+		int64_t time = INT64_MAX;
+		for (auto& other : partitions) {
+			time = std::min(time, other.nextTime);
+		}
+		if (time == INT64_MAX || (endTime != -1 && time > endTime)) {
+			break;
+		}
+		if (p == 0) {
+			lastTime = time;
+		}
+
+		for (auto& changes : partition.groupChanges) {
+			changes.clear();
+		}
+		for (auto& receivers : partition.receivers) {
+			receivers.clear();
+		}
+
+		processEvents(p, time);
+		sync();
+		processGroupChanges(p);
+		sync();
+
+		for (auto& other : partitions) {
+			for (Index pin : other.receivers[p]) {
+				partition.queue.add(pin, time, false);
+			}
+		}
+		processEvents(p, time);
+		partition.nextTime = partition.queue.empty() ? INT64_MAX : partition.queue.get().time;
+		sync();
+	}
+}
+
+void ParallelSimulator::addEvent(Index pin, int64_t time) {
+	partitions[partitionByPin[pin]].queue.add(pin, time, false);
+}
+
+void ParallelSimulator::processExternal(Index pin, int64_t time) {
+	auto& netlist = *circuit->netlist;
+	Index group = netlist.groupByPin[pin];
+	if (netlist.pins[pin] == PinType::CONNECTOR && group != -1) {
+		circuit->state.groupForced[group] = circuit->state.pinStates[pin];
+	}
+
+	Index destination = netlist.outboundPin[pin];
+	if (destination == -2) {
+		uint8_t value = circuit->getGroupValue(group);
+		Index end = netlist.groupTapOffsets[group + 1];
+		for (Index i = netlist.groupTapOffsets[group]; i < end; i++) {
+			Index tap = netlist.groupTaps[i];
+			if (tap != pin) {
+				circuit->state.pinStates[tap] = value;
+			}
+		}
+		end = netlist.groupReceiverOffsets[group + 1];
+		for (Index i = netlist.groupReceiverOffsets[group]; i < end; i++) {
+			addEvent(netlist.groupReceivers[i], time);
+		}
+	}
+	else if (destination != -1) {
+		addEvent(destination, time);
+	}
+}
+
+void ParallelSimulator::processEvents(Index p, int64_t time) {
+	auto& queue = partitions[p].queue;
+	auto& stats = partitions[p].stats;
+	auto& pinStates = circuit->state.pinStates;
+
+	while (!queue.empty()) {
+		auto event = queue.get();
+		if (event.time != time) {
+			break;
+		}
+		int64_t queueDepth = queue.size();
+		stats.queueDepthSum += queueDepth;
+		if (queueDepth > stats.peakQueueDepth) {
+			stats.peakQueueDepth = queueDepth;
+		}
+		stats.events++;
+		queue.pop();
+
+		Index pin = event.pin;
+		const PinDescriptor& descriptor = circuit->netlist->pinDescriptors[pin];
+		stats.eventsByPinType[(int)descriptor.type]++;
+
+		switch (descriptor.baseType)
+		{
+		case PinBaseType::CONNECTOR: {
+			if (descriptor.type == PinType::CONNECTOR) {
+				pinStates[pin] = circuit->getInboundSignal(pin, stats);
+			}
+			else if (descriptor.type == PinType::OUTPUT) {
+				sendOutbound(p, pin, 0);
+			}
+			break;
+		}
+		case PinBaseType::INPUT: {
+			uint8_t value = circuit->getInboundSignal(pin, stats);
+			if (pinStates[pin] != value) {
+				pinStates[pin] = value;
+				queue.add(pin + descriptor.offset, time + descriptor.delay, false);
+			}
+			else {
+				stats.unchangedEvents++;
+			}
+			break;
+		}
+		case PinBaseType::OUTPUT: {
+			uint8_t oldValue = pinStates[pin];
+			int index = (oldValue << 2) | (pinStates[pin + descriptor.offset] << 1) | pinStates[pin - 1];
+			uint8_t value = (descriptor.truthTable >> index) & 1;
+			if (oldValue != value) {
+				pinStates[pin] = value;
+				sendOutbound(p, pin, value ? 1 : -1);
+			}
+			else {
+				stats.unchangedEvents++;
+			}
+			break;
+		}
+		case PinBaseType::BLOCK_INPUT: {
+			uint8_t value = circuit->getInboundSignal(pin, stats);
+			if (pinStates[pin] != value) {
+				pinStates[pin] = value;
+				queue.add(circuit->netlist->getBlock(pin).getOutputPin(), time + descriptor.delay, false);
+			}
+			else {
+				stats.unchangedEvents++;
+			}
+			break;
+		}
+		case PinBaseType::BLOCK_OUTPUT: {
+			//a block lies within one partition, so its memory is only touched by this thread
+			const Block& block = circuit->netlist->getBlock(pin);
+			bool changed = false;
+			evaluateBlock(block, pinStates.data(), circuit->state.blockMemory.data() + block.memoryOffset, [&](Index output, uint8_t value) {
+				if (pinStates[output] != value) {
+					changed = true;
+					pinStates[output] = value;
+					sendOutbound(p, output, value ? 1 : -1);
+				}
+			});
+			if (!changed) {
+				stats.unchangedEvents++;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+void ParallelSimulator::sendOutbound(Index p, Index pin, int8_t delta) {
+	auto& netlist = *circuit->netlist;
+	auto& partition = partitions[p];
+	Index group = netlist.groupByDriver[pin];
+	Index destination = netlist.outboundPin[pin];
+	if (group != -1 && (delta != 0 || destination == -2)) {
+		partition.groupChanges[partitionByGroup[group]].push_back({ group, pin, delta });
+	}
+	if (destination >= 0) {
+		partition.receivers[partitionByPin[destination]].push_back(destination);
+	}
+}
+
+void ParallelSimulator::processGroupChanges(Index p) {
+	auto& netlist = *circuit->netlist;
+	auto& partition = partitions[p];
+	partition.touchedGroups.clear();
+	for (auto& other : partitions) {
+		for (auto& change : other.groupChanges[p]) {
+			Index group = change.group;
+			if (change.delta != 0) {
+				circuit->state.groupHighCount[group] += change.delta;
+				circuit->state.groupForced[group] = false;
+			}
+			if (netlist.outboundPin[change.pin] == -2 && !groupTouched[group]) {
+				groupTouched[group] = 1;
+				partition.touchedGroups.push_back(group);
+			}
+		}
+	}
+
+	//taps and receivers see the final net value of the step
+	for (Index group : partition.touchedGroups) {
+		groupTouched[group] = 0;
+		uint8_t value = circuit->getGroupValue(group);
+		Index end = netlist.groupTapOffsets[group + 1];
+		for (Index i = netlist.groupTapOffsets[group]; i < end; i++) {
+			circuit->state.pinStates[netlist.groupTaps[i]] = value;
+		}
+		end = netlist.groupReceiverOffsets[group + 1];
+		for (Index i = netlist.groupReceiverOffsets[group]; i < end; i++) {
+			Index receiver = netlist.groupReceivers[i];
+			partition.receivers[partitionByPin[receiver]].push_back(receiver);
+		}
+	}
+}
@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "type.h"
+#include "EventQueue.h"
+#include "SimulationStats.h"
+#include <vector>
+#include <thread>
+#include <barrier>
+#include <memory>
+
+//event driven simulation with the pins partitioned over multiple threads
+//each partition owns a range of whole gates with its own event queue and each net is owned by one partition,
+//all partitions advance together in lock step, one time step at a time with three barriers per step:
+//  1. gate outputs of the step are evaluated, changed drivers are sent to the owners of their nets
+//  2. net owners update the net values and taps and send the receivers to their partitions
+//  3. receivers read their net and schedule their gate output at least one gate delay later
+//the phases match the order in which the sorted sequential engine processes one time step,
+//so the results match it as long as every gate delay is at least one time unit (see testParallel in cpu.cpp)
+//no partition runs ahead of the others, the gate delays are not used as a lookahead window
+//the barriers cost more than the work of a step on small circuits, scaling to 8-32 cores is unproven
+class ParallelSimulator {
+public:
+	//a driver of a net changed by delta, or was triggered without a change for delta 0
+	class GroupChange {
+	public:
+		Index group;
+		Index pin;
+		int8_t delta;
+	};
+
+	class Partition {
+	public:
+		Index beginPin = 0;
+		Index endPin = 0;
+		EventQueue queue;
+		//merged into the circuit counters after each simulate call
+		SimulationStats stats;
+		int64_t nextTime = 0;
+		//messages to other partitions, indexed by the destination partition
+		std::vector<std::vector<GroupChange>> groupChanges;
+		std::vector<std::vector<Index>> receivers;
+		//nets owned by this partition that need an update in the current step
+		std::vector<Index> touchedGroups;
+	};
+
+	class Circuit* circuit = nullptr;
+	std::vector<Partition> partitions;
+	std::vector<uint16_t> partitionByPin;
+	std::vector<uint16_t> partitionByGroup;
+	std::vector<uint8_t> groupTouched;
+
+	~ParallelSimulator();
+	void build(Circuit* circuit, int threadCount);
+	int getThreadCount();
+	//smallest delay from a gate input to its output, only checked to be at least one time unit
+	int getLookahead();
+	//fillTime: see Circuit::run
+	int simulate(int timeUnits, bool fillTime = true);
+	bool hasEvents();
+
+private:
+	std::vector<std::thread> threads;
+	std::unique_ptr<std::barrier<>> barrier;
+	bool stopping = false;
+	int64_t endTime = -1;
+	int64_t lastTime = 0;
+
+	std::vector<Index> externalPins;
+
+	void startThreads();
+	void stopThreads();
+	void sync();
+	void run(Index partition);
+	void addEvent(Index pin, int64_t time);
+	void processExternal(Index pin, int64_t time);
+	void processEvents(Index partition, int64_t time);
+	void processGroupChanges(Index partition);
+	void sendOutbound(Index partition, Index pin, int8_t delta);
+};
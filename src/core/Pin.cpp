@@ -80,20 +80,45 @@ Pin Pin::dLatch(Pin enable) {
 }
 
 Pin Pin::zero() {
-	return connector();
+	Pin pin = connector();
+	circuit->editNetlist().constantPins.push_back(pin.index);
+	return pin;
 }
 
 Pin Pin::one() {
-	return connector().NOT();
+	return zero().NOT();
+}
+
+Pin Pin::rebind(Circuit* circuit) {
+	return Pin(circuit, index);
 }
 
 bool Pin::getValue() {
-	return circuit->pinStates[index];
+	return circuit->getPinValue(index);
 }
 
 void Pin::setValue(bool value) {
-	if (circuit->pinStates[index] != value) {
-		circuit->pinStates[index] = value;
-		circuit->changedPins.push_back(index);
+	circuit->setPinValue(index, value);
+}
+
+bool Pin::getValue(int lane) {
+	if (lane < 0 || lane >= 64) {
+		return false;
+	}
+	return (circuit->getPinLanes(index) >> lane) & 1;
+}
+
+bool Pin::setValue(bool value, int lane) {
+	if (lane < 0 || lane >= 64) {
+		return false;
 	}
+	return circuit->setPinLanes(index, value ? ~0ull : 0, 1ull << lane);
+}
+
+uint64_t Pin::getLanes() {
+	return circuit->getPinLanes(index);
+}
+
+void Pin::setLanes(uint64_t lanes) {
+	circuit->setPinLanes(index, lanes);
 }
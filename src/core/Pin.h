@@ -29,6 +29,17 @@ public:
 	Pin zero();
 	Pin one();
 
+	//the same pin in another circuit sharing the netlist
+	Pin rebind(Circuit* circuit);
+
 	bool getValue();
 	void setValue(bool value);
+
+	//lane aware access, used with multiple lanes on the levelized engine (see Circuit::setLaneCount)
+	//lanes that are not simulated read as 0, setting one returns false and changes nothing
+	bool getValue(int lane);
+	bool setValue(bool value, int lane);
+	uint64_t getLanes();
+	//bits of lanes that are not simulated are ignored
+	void setLanes(uint64_t lanes);
 };
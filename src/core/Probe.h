@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "type.h"
+#include <vector>
+#include <string>
+#include <cstdio>
+
+//probes are compiled in unless the build sets ICSIM_PROBES to 0, cmake only compiles them into debug builds by default
+#ifndef ICSIM_PROBES
+#define ICSIM_PROBES 1
+#endif
+
+//keeps the last transitions of a set of pins in a fixed size ring, armed with Circuit::addProbe
+class Probe {
+public:
+	class Transition {
+	public:
+		int64_t time = 0;
+		Index pin = -1;
+		uint8_t value = 0;
+	};
+
+	std::string name;
+	std::vector<Index> pins;
+	std::vector<Transition> ring;
+	Index position = 0;
+	//all transitions seen since the probe was armed
+	int64_t count = 0;
+
+	void record(int64_t time, Index pin, bool value) {
+		ring[position] = { time, pin, value };
+		if (++position == ring.size()) {
+			position = 0;
+		}
+		count++;
+	}
+
+	//oldest first
+	std::vector<Transition> getTransitions() const {
+		std::vector<Transition> transitions;
+		if (count >= (int64_t)ring.size()) {
+			transitions.insert(transitions.end(), ring.begin() + position, ring.end());
+		}
+		transitions.insert(transitions.end(), ring.begin(), ring.begin() + position);
+		return transitions;
+	}
+
+	void dump(FILE* file = stdout) const {
+		auto transitions = getTransitions();
+		fprintf(file, "probe %s: %i pins, %lli transitions, last %i:\n", name.c_str(), (int)pins.size(), (long long)count, (int)transitions.size());
+		for (auto& transition : transitions) {
+			int bit = 0;
+			while (bit < pins.size() && pins[bit] != transition.pin) {
+				bit++;
+			}
+			fprintf(file, "  %8lli: bit %2i (pin %i) -> %i\n", (long long)transition.time, bit, transition.pin, (int)transition.value);
+		}
+	}
+};
@@ -0,0 +1,119 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#include "SimulationFarm.h"
+#include "util/Clock.h"
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <atomic>
+
+class SimulationFarm::Worker {
+public:
+	std::mutex mutex;
+	std::deque<Index> jobs;
+
+	bool take(Index& job) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (jobs.empty()) {
+			return false;
+		}
+		job = jobs.back();
+		jobs.pop_back();
+		return true;
+	}
+
+	bool steal(Index& job) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (jobs.empty()) {
+			return false;
+		}
+		job = jobs.front();
+		jobs.pop_front();
+		return true;
+	}
+};
+
+void SimulationFarm::setThreadCount(int count) {
+	threadCount = std::max(count, 1);
+}
+
+int SimulationFarm::getThreadCount() {
+	return threadCount;
+}
+
+const FarmStats& SimulationFarm::getStats() {
+	return stats;
+}
+
+void SimulationFarm::run(std::shared_ptr<Netlist> netlist, std::vector<SimulationJob>& jobs) {
+	Clock clock;
+	int count = std::max(1, std::min(threadCount, (int)jobs.size()));
+
+	//jobs are dealt out in contiguous blocks, so neighbouring jobs of similar size stay on one thread
+	std::vector<Worker> workers(count);
+	for (Index i = 0; i < jobs.size(); i++) {
+		workers[(int64_t)i * count / jobs.size()].jobs.push_back(i);
+	}
+
+	std::atomic<int64_t> steals = 0;
+	auto work = [&](int thread) {
+		Index job;
+		while (true) {
+			if (workers[thread].take(job)) {
+				runJob(netlist, jobs[job], thread);
+				continue;
+			}
+			bool stolen = false;
+			for (int i = 1; i < count && !stolen; i++) {
+				stolen = workers[(thread + i) % count].steal(job);
+			}
+			if (!stolen) {
+				//jobs never create new jobs, so all queues are empty for good
+				break;
+			}
+			steals++;
+			runJob(netlist, jobs[job], thread);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < count; i++) {
+		threads.emplace_back(work, i);
+	}
+	work(0);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	stats = FarmStats();
+	stats.jobCount = jobs.size();
+	stats.threadCount = count;
+	stats.time = clock.elapsed();
+	stats.jobsPerSecond = stats.time > 0 ? jobs.size() / stats.time : 0;
+	stats.steals = steals;
+	for (auto& job : jobs) {
+		stats.events += job.stats.events;
+	}
+}
+
+void SimulationFarm::runJob(const std::shared_ptr<Netlist>& netlist, SimulationJob& job, int thread) {
+	Clock clock;
+	Circuit circuit;
+	circuit.setNetlist(netlist);
+
+	if (job.stimulus) {
+		job.stimulus(circuit);
+	}
+	job.results.clear();
+	for (auto& bus : job.outputs) {
+		job.results.push_back(bus.rebind(&circuit).getValue());
+	}
+
+	job.stats.time = clock.elapsed();
+	job.stats.simulationTime = circuit.getSimulationTime();
+	job.stats.events = circuit.getStats().events;
+	job.stats.eventsPerSecond = job.stats.time > 0 ? job.stats.events / job.stats.time : 0;
+	job.stats.thread = thread;
+}
@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "Circuit.h"
+#include "Bus.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+class JobStats {
+public:
+	//wall time of the job on its thread
+	double time = 0;
+	int64_t simulationTime = 0;
+	int64_t events = 0;
+	double eventsPerSecond = 0;
+	int thread = -1;
+};
+
+class FarmStats {
+public:
+	int jobCount = 0;
+	int threadCount = 0;
+	double time = 0;
+	double jobsPerSecond = 0;
+	int64_t events = 0;
+	//jobs taken from the queue of another thread
+	int64_t steals = 0;
+};
+
+//an independent simulation on a shared netlist
+class SimulationJob {
+public:
+	//applies the stimulus to a fresh circuit running on the netlist
+	std::function<void(Circuit& circuit)> stimulus;
+	//buses read after the stimulus, one result per bus
+	std::vector<Bus> outputs;
+	std::vector<uint64_t> results;
+	JobStats stats;
+};
+
+//runs many jobs on one prepared netlist with a work stealing thread pool
+//every thread takes jobs from the back of its own queue and steals from the front of the others when it runs out
+class SimulationFarm {
+public:
+	void setThreadCount(int count);
+	int getThreadCount();
+	//blocks until all jobs are done
+	void run(std::shared_ptr<Netlist> netlist, std::vector<SimulationJob>& jobs);
+	const FarmStats& getStats();
+
+private:
+	class Worker;
+	int threadCount = 1;
+	FarmStats stats;
+
+	void runJob(const std::shared_ptr<Netlist>& netlist, SimulationJob& job, int thread);
+};
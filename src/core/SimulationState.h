@@ -0,0 +1,41 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "type.h"
+#include "Netlist.h"
+#include "EventQueue.h"
+#include <vector>
+
+//mutable state of one simulation of a netlist
+class SimulationState {
+public:
+	std::vector<uint8_t> pinStates;
+	std::vector<Index> changedPins;
+
+	//net value is high when a driver is high or a tap was set high from outside
+	//the tap value is overwritten by the next driver change
+	std::vector<Index> groupHighCount;
+	std::vector<uint8_t> groupForced;
+
+	EventQueue queue;
+	int64_t simulationTime = 0;
+
+	//contents of all memory blocks, see Block.h
+	std::vector<uint8_t> blockMemory;
+
+	//starts from the settled state of a prepared netlist
+	void reset(const Netlist& netlist) {
+		pinStates = netlist.initialPinStates;
+		changedPins.clear();
+		groupHighCount = netlist.initialGroupHighCount;
+		groupForced.clear();
+		groupForced.resize(netlist.groupCount, 0);
+		queue.clear();
+		queue.resize(netlist.pins.size());
+		simulationTime = 0;
+		blockMemory.assign(netlist.getBlockMemorySize(), 0);
+	}
+};
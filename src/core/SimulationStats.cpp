@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#include "SimulationStats.h"
+#include <algorithm>
+
+double SimulationStats::getAverageQueueDepth() const {
+	return events > 0 ? (double)queueDepthSum / events : 0;
+}
+
+void SimulationStats::add(const SimulationStats& other) {
+	for (int i = 0; i < (int)PinType::PIN_TYPE_COUNT; i++) {
+		eventsByPinType[i] += other.eventsByPinType[i];
+	}
+	events += other.events;
+	externalEvents += other.externalEvents;
+	clockEdges += other.clockEdges;
+	unchangedEvents += other.unchangedEvents;
+	groupReads += other.groupReads;
+	queuedEvents += other.queuedEvents;
+	deduplicatedEvents += other.deduplicatedEvents;
+	peakQueueDepth = std::max(peakQueueDepth, other.peakQueueDepth);
+	queueDepthSum += other.queueDepthSum;
+	sweeps += other.sweeps;
+	evaluations += other.evaluations;
+	simulateCalls += other.simulateCalls;
+	simulatedTime += other.simulatedTime;
+	time += other.time;
+}
+
+std::string SimulationStats::toJson() const {
+	std::string json = "{";
+	auto field = [&](const char* name, const std::string& value) {
+		if (json.size() > 1) {
+			json += ", ";
+		}
+		json += std::string("\"") + name + "\": " + value;
+	};
+
+	field("events", std::to_string(events));
+	field("externalEvents", std::to_string(externalEvents));
+	field("clockEdges", std::to_string(clockEdges));
+	field("unchangedEvents", std::to_string(unchangedEvents));
+	field("groupReads", std::to_string(groupReads));
+	field("queuedEvents", std::to_string(queuedEvents));
+	field("deduplicatedEvents", std::to_string(deduplicatedEvents));
+	field("peakQueueDepth", std::to_string(peakQueueDepth));
+	field("averageQueueDepth", std::to_string(getAverageQueueDepth()));
+	field("sweeps", std::to_string(sweeps));
+	field("evaluations", std::to_string(evaluations));
+	field("simulateCalls", std::to_string(simulateCalls));
+	field("simulatedTime", std::to_string(simulatedTime));
+	field("time", std::to_string(time));
+
+	std::string byType = "{";
+	for (int i = 0; i < (int)PinType::PIN_TYPE_COUNT; i++) {
+		if (eventsByPinType[i] != 0) {
+			if (byType.size() > 1) {
+				byType += ", ";
+			}
+			byType += std::string("\"") + getPinTypeName((PinType)i) + "\": " + std::to_string(eventsByPinType[i]);
+		}
+	}
+	field("eventsByPinType", byType + "}");
+	return json + "}";
+}
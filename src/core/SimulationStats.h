@@ -0,0 +1,56 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "type.h"
+#include <string>
+
+//counters of the engines, the levelized engine only counts sweeps, evaluations, simulate calls and time
+class SimulationStats {
+public:
+	//events taken from the queue by the type of their pin, external events are counted on their own
+	int64_t eventsByPinType[(int)PinType::PIN_TYPE_COUNT] = {};
+	int64_t events = 0;
+	int64_t externalEvents = 0;
+	//edges of the clocks added with Circuit::addClock
+	int64_t clockEdges = 0;
+	//gate and block events that did not change any value
+	int64_t unchangedEvents = 0;
+	//input events that read a net with several drivers or taps instead of a single driver pin
+	int64_t groupReads = 0;
+	//events added to the queue and events dropped because the pin was still pending
+	int64_t queuedEvents = 0;
+	int64_t deduplicatedEvents = 0;
+	//queue size when an event is taken
+	int64_t peakQueueDepth = 0;
+	int64_t queueDepthSum = 0;
+	//levelized engine: passes in rank order over the dirty nodes and the nodes evaluated in them
+	int64_t sweeps = 0;
+	int64_t evaluations = 0;
+
+	int64_t simulateCalls = 0;
+	int64_t simulatedTime = 0;
+	//seconds spent in simulate
+	double time = 0;
+
+	double getAverageQueueDepth() const;
+	//adds the counters of other, the peak is the larger one
+	void add(const SimulationStats& other);
+	//one line json object
+	std::string toJson() const;
+};
+
+//events and glitches of a scope named with Circuit::pushScope
+class ScopeActivity {
+public:
+	std::string name;
+	//gates and blocks placed directly in the scope, nested scopes are counted on their own
+	int gates = 0;
+	int64_t events = 0;
+	//gate outputs that changed and changed back within one phase, a simulate call or the time between two clock edges
+	int64_t glitches = 0;
+	//part of all counted events
+	double share = 0;
+};
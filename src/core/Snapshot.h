@@ -0,0 +1,32 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "type.h"
+#include "EventQueue.h"
+#include <vector>
+
+//copy of the simulation state of a circuit, every part is a flat buffer of plain values
+//a snapshot can be restored into any circuit running on the same netlist
+class Snapshot {
+public:
+	std::vector<uint8_t> pinStates;
+	std::vector<Index> changedPins;
+	std::vector<Index> groupHighCount;
+	std::vector<uint8_t> groupForced;
+	//pending events in processing order
+	std::vector<EventQueue::Event> events;
+	int64_t simulationTime = 0;
+	int64_t addedCount = 0;
+	int64_t skippedCount = 0;
+	std::vector<uint8_t> blockMemory;
+
+	//node state of the levelized engine, empty when taken with another engine
+	std::vector<uint64_t> nodeValues;
+	std::vector<uint64_t> nodeDriverValues;
+	std::vector<uint64_t> nodeForcedValues;
+	std::vector<uint64_t> nodeDirty;
+	uint64_t laneMask = 0;
+};
@@ -0,0 +1,25 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "Pin.h"
+#include "Bus.h"
+#include <map>
+#include <string>
+
+class Circuit;
+
+//an instance of a module, returned by Circuit::addInstance
+class SubCircuit {
+public:
+	Circuit* circuit = nullptr;
+	Index module = -1;
+	Index firstPin = -1;
+	std::string name;
+
+	//ports of the instance, ports with a single pin are in both maps
+	std::map<std::string, Bus> buses;
+	std::map<std::string, Pin> pins;
+};
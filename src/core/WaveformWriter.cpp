@@ -0,0 +1,250 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#include "WaveformWriter.h"
+#include <cstring>
+
+//binary format, all numbers are LEB128 varints unless noted:
+//  magic "ICSIMWF\0" (8 bytes), version (uint32), signal count
+//  per signal: width, scope length, scope bytes, name length, name bytes
+//  then one entry per bit change: time delta to the previous entry, (bit << 1) | value
+//bits are numbered over all signals in order, a signal covers the bits firstBit to firstBit + width - 1
+
+static const char waveformMagic[8] = { 'I', 'C', 'S', 'I', 'M', 'W', 'F', '\0' };
+static const uint32_t waveformVersion = 1;
+
+static const uint64_t bufferSize = 1 << 16;
+//the writer thread writes to the file in chunks of this size
+static const size_t outputChunkSize = 1 << 16;
+
+static void writeVarint(std::string& output, uint64_t value) {
+	while (value >= 0x80) {
+		output.push_back((char)(value | 0x80));
+		value >>= 7;
+	}
+	output.push_back((char)value);
+}
+
+//printable identifier codes used by VCD, base 94
+static std::string vcdIdentifier(Index index) {
+	std::string id;
+	do {
+		id.push_back((char)('!' + index % 94));
+		index /= 94;
+	} while (index > 0);
+	return id;
+}
+
+WaveformWriter::~WaveformWriter() {
+	close();
+}
+
+void WaveformWriter::addSignal(const std::string& scope, const std::string& name, Bus bus) {
+	Signal signal;
+	signal.scope = scope;
+	signal.name = name;
+	signal.firstBit = bitPins.size();
+	signal.width = bus.size();
+	for (int i = 0; i < bus.size(); i++) {
+		bitPins.push_back(bus.getPin(i).index);
+	}
+	signals.push_back(signal);
+}
+
+void WaveformWriter::addSignal(const std::string& scope, const std::string& name, Pin pin) {
+	Bus bus;
+	bus.circuit = pin.circuit;
+	bus.addPin(pin);
+	addSignal(scope, name, bus);
+}
+
+bool WaveformWriter::open(const std::string& file, WaveformFormat format) {
+	close();
+	stream.open(file, std::ios::binary);
+	if (!stream) {
+		return false;
+	}
+	this->format = format;
+	buffer.assign(bufferSize, {});
+	bufferMask = bufferSize - 1;
+	head = 0;
+	tail = 0;
+	cachedTail = 0;
+	closing = false;
+	stallCount = 0;
+
+	bitValues.assign(bitPins.size(), 2);
+	signalByBit.resize(bitPins.size());
+	for (Index i = 0; i < signals.size(); i++) {
+		for (int bit = 0; bit < signals[i].width; bit++) {
+			signalByBit[signals[i].firstBit + bit] = i;
+		}
+	}
+	dirtySignals.assign(signals.size(), 0);
+	dirtyList.clear();
+	currentTime = -1;
+	lastBinaryTime = 0;
+	bytesWritten = 0;
+	output.clear();
+
+	writeHeader();
+	thread = std::thread([this]() {
+		run();
+	});
+	capturing = true;
+	return true;
+}
+
+void WaveformWriter::close() {
+	capturing = false;
+	if (!thread.joinable()) {
+		return;
+	}
+	closing = true;
+	thread.join();
+	flushTime();
+	flushOutput(true);
+	stream.close();
+}
+
+bool WaveformWriter::isOpen() {
+	return thread.joinable();
+}
+
+int64_t WaveformWriter::getChangeCount() {
+	return head.load();
+}
+
+int64_t WaveformWriter::getStallCount() {
+	return stallCount;
+}
+
+int64_t WaveformWriter::getBytesWritten() {
+	return bytesWritten;
+}
+
+void WaveformWriter::waitForSpace(uint64_t index) {
+	cachedTail = tail.load(std::memory_order_acquire);
+	while (index - cachedTail >= buffer.size()) {
+		stallCount++;
+		std::this_thread::yield();
+		cachedTail = tail.load(std::memory_order_acquire);
+	}
+}
+
+void WaveformWriter::run() {
+	uint64_t index = tail.load(std::memory_order_relaxed);
+	while (true) {
+		//closing is read before head, so no change is left behind when the loop ends
+		bool last = closing.load(std::memory_order_acquire);
+		uint64_t end = head.load(std::memory_order_acquire);
+		if (index == end) {
+			if (last) {
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			continue;
+		}
+		for (; index != end; index++) {
+			writeChange(buffer[index & bufferMask]);
+		}
+		tail.store(index, std::memory_order_release);
+		flushOutput(false);
+	}
+}
+
+void WaveformWriter::writeHeader() {
+	if (format == WaveformFormat::BINARY) {
+		output.append(waveformMagic, sizeof(waveformMagic));
+		output.append((const char*)&waveformVersion, sizeof(waveformVersion));
+		writeVarint(output, signals.size());
+		for (auto& signal : signals) {
+			writeVarint(output, signal.width);
+			writeVarint(output, signal.scope.size());
+			output += signal.scope;
+			writeVarint(output, signal.name.size());
+			output += signal.name;
+		}
+		return;
+	}
+
+	identifiers.clear();
+	for (Index i = 0; i < signals.size(); i++) {
+		identifiers.push_back(vcdIdentifier(i));
+	}
+	output += "$timescale 1ns $end\n";
+	std::vector<uint8_t> written(signals.size(), 0);
+	for (Index i = 0; i < signals.size(); i++) {
+		if (written[i]) {
+			continue;
+		}
+		const std::string& scope = signals[i].scope;
+		output += "$scope module " + scope + " $end\n";
+		for (Index k = i; k < signals.size(); k++) {
+			if (!written[k] && signals[k].scope == scope) {
+				written[k] = 1;
+				output += "$var wire " + std::to_string(signals[k].width) + " " + identifiers[k] + " " + signals[k].name;
+				if (signals[k].width > 1) {
+					output += " [" + std::to_string(signals[k].width - 1) + ":0]";
+				}
+				output += " $end\n";
+			}
+		}
+		output += "$upscope $end\n";
+	}
+	output += "$enddefinitions $end\n";
+}
+
+void WaveformWriter::writeChange(const Change& change) {
+	if (format == WaveformFormat::BINARY) {
+		writeVarint(output, change.time - lastBinaryTime);
+		writeVarint(output, ((uint64_t)change.bit << 1) | change.value);
+		lastBinaryTime = change.time;
+		return;
+	}
+
+	//VCD writes whole signals, the bits of one time step are collected first
+	if (change.time != currentTime) {
+		flushTime();
+		currentTime = change.time;
+	}
+	bitValues[change.bit] = change.value;
+	Index signal = signalByBit[change.bit];
+	if (!dirtySignals[signal]) {
+		dirtySignals[signal] = 1;
+		dirtyList.push_back(signal);
+	}
+}
+
+void WaveformWriter::flushTime() {
+	if (dirtyList.empty()) {
+		return;
+	}
+	output += "#" + std::to_string(currentTime) + "\n";
+	for (Index index : dirtyList) {
+		const Signal& signal = signals[index];
+		if (signal.width == 1) {
+			output.push_back("01x"[bitValues[signal.firstBit]]);
+		}
+		else {
+			output.push_back('b');
+			for (int bit = signal.width - 1; bit >= 0; bit--) {
+				output.push_back("01x"[bitValues[signal.firstBit + bit]]);
+			}
+			output.push_back(' ');
+		}
+		output += identifiers[index];
+		output.push_back('\n');
+		dirtySignals[index] = 0;
+	}
+	dirtyList.clear();
+}
+
+void WaveformWriter::flushOutput(bool force) {
+	if (output.size() >= outputChunkSize || (force && !output.empty())) {
+		stream.write(output.data(), output.size());
+		bytesWritten += output.size();
+		output.clear();
+	}
+}
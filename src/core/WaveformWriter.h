@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "type.h"
+#include "Pin.h"
+#include "Bus.h"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <fstream>
+
+enum class WaveformFormat : uint8_t {
+	//value change dump, readable by common waveform viewers
+	VCD,
+	//compact binary stream (see WaveformWriter.cpp)
+	BINARY,
+};
+
+//streams value changes of selected pins and buses to a file
+//the simulation thread only appends changes to a lock free ring buffer, a background thread encodes and writes them
+//usage: add the signals, open the file, then attach it with Circuit::setWaveformWriter
+class WaveformWriter {
+public:
+	class Signal {
+	public:
+		std::string scope;
+		std::string name;
+		Index firstBit = 0;
+		int width = 0;
+	};
+
+	//a signal is a list of bits, scopes group the signals in the order they are first used
+	std::vector<Signal> signals;
+	std::vector<Index> bitPins;
+
+	~WaveformWriter();
+
+	void addSignal(const std::string& scope, const std::string& name, Bus bus);
+	void addSignal(const std::string& scope, const std::string& name, Pin pin);
+
+	bool open(const std::string& file, WaveformFormat format = WaveformFormat::VCD);
+	//writes all captured changes and stops the writer thread, later changes are dropped
+	void close();
+	bool isOpen();
+
+	int64_t getChangeCount();
+	//number of times the simulation had to wait for the writer because the buffer was full
+	int64_t getStallCount();
+	int64_t getBytesWritten();
+
+	//called by the simulation thread, values are recorded in time order, ignored while the writer is not open
+	void capture(int64_t time, Index bit, bool value) {
+		if (!capturing) {
+			return;
+		}
+		uint64_t index = head.load(std::memory_order_relaxed);
+		if (index - cachedTail >= buffer.size()) {
+			waitForSpace(index);
+		}
+		buffer[index & bufferMask] = { time, bit, value };
+		head.store(index + 1, std::memory_order_release);
+	}
+
+private:
+	class Change {
+	public:
+		int64_t time;
+		Index bit;
+		uint8_t value;
+	};
+
+	//single producer single consumer ring, head is written by the simulation and tail by the writer thread
+	std::vector<Change> buffer;
+	uint64_t bufferMask = 0;
+	std::atomic<uint64_t> head = 0;
+	std::atomic<uint64_t> tail = 0;
+	uint64_t cachedTail = 0;
+	std::atomic<bool> closing = false;
+	//only set between open and close, so capture never waits on a writer thread that does not run
+	bool capturing = false;
+	int64_t stallCount = 0;
+	std::thread thread;
+
+	//owned by the writer thread while open
+	WaveformFormat format = WaveformFormat::VCD;
+	std::ofstream stream;
+	std::string output;
+	std::vector<uint8_t> bitValues;
+	std::vector<Index> signalByBit;
+	std::vector<uint8_t> dirtySignals;
+	std::vector<Index> dirtyList;
+	std::vector<std::string> identifiers;
+	int64_t currentTime = -1;
+	int64_t lastBinaryTime = 0;
+	int64_t bytesWritten = 0;
+
+	void waitForSpace(uint64_t index);
+	void run();
+	void writeHeader();
+	void writeChange(const Change& change);
+	void flushTime();
+	void flushOutput(bool force);
+};
@@ -53,3 +53,46 @@ Pin tLatch(Pin toggle) {
 	dLatch(dLatch(q, toggle.NOT()), toggle).NOT().connect(q);
 	return q.NOT();
 }
+
+//connects the inputs in order and returns the output pins of the block
+static Bus connectBlock(Circuit* circuit, Index block, std::initializer_list<Bus> inputs, int outputCount) {
+	Index pin = block;
+	for (auto bus : inputs) {
+		for (int i = 0; i < bus.size(); i++) {
+			bus.getPin(i).connect(Pin(circuit, pin++));
+		}
+	}
+	Bus output;
+	output.circuit = circuit;
+	for (int i = 0; i < outputCount; i++) {
+		output.addPin(Pin(circuit, pin++));
+	}
+	return output;
+}
+
+static Bus toBus(Pin pin) {
+	Bus bus;
+	bus.circuit = pin.circuit;
+	bus.addPin(pin);
+	return bus;
+}
+
+Bus wordAdder(Bus a, Bus b, Pin carry) {
+	Index block = a.circuit->addBlock(GateType::WORD_ADD, a.size());
+	return connectBlock(a.circuit, block, { a, b, toBus(carry) }, a.size() + 1);
+}
+
+Bus wordLatch(Bus data, Pin enable) {
+	Index block = data.circuit->addBlock(GateType::WORD_LATCH, data.size());
+	return connectBlock(data.circuit, block, { data, toBus(enable) }, data.size());
+}
+
+Bus wordDecoder(Bus select) {
+	Index block = select.circuit->addBlock(GateType::WORD_DECODER, select.size());
+	return connectBlock(select.circuit, block, { select }, 1 << select.size());
+}
+
+Bus wordAnd(Bus data, Pin enable) {
+	Index block = data.circuit->addBlock(GateType::WORD_AND, data.size());
+	return connectBlock(data.circuit, block, { data, toBus(enable) }, data.size());
+}
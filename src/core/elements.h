@@ -13,3 +13,16 @@ Pin dLatch(Pin data, Pin enable);
 Bus multiplexer(Bus input);
 
 Pin tLatch(Pin toggle);
+
+//word level elements, each is a single block that is evaluated as a whole (see Block.h)
+
+//sum of a, b and carry, the last pin of the result is the carry out
+Bus wordAdder(Bus a, Bus b, Pin carry);
+
+Bus wordLatch(Bus data, Pin enable);
+
+//same as multiplexer
+Bus wordDecoder(Bus select);
+
+//same as Bus::AND
+Bus wordAnd(Bus data, Pin enable);
@@ -57,7 +57,135 @@ PinBaseType getPinBaseType(PinType type) {
 		return PinBaseType::OUTPUT;
 	case PinType::DISABLED:
 		return PinBaseType::CONNECTOR;
+	case PinType::BLOCK_IN:
+		return PinBaseType::BLOCK_INPUT;
+	case PinType::BLOCK_OUT:
+		return PinBaseType::BLOCK_OUTPUT;
 	default:
 		return PinBaseType::CONNECTOR;
 	}
 }
+
+const char* getPinTypeName(PinType type) {
+	static const char* names[] = {
+		"CONNECTOR", "OUTPUT", "BUF_IN", "BUF_OUT", "NOT_IN", "NOT_OUT",
+		"OR_A", "OR_B", "OR_OUT", "AND_A", "AND_B", "AND_OUT",
+		"NOR_A", "NOR_B", "NOR_OUT", "NAND_A", "NAND_B", "NAND_OUT",
+		"XOR_A", "XOR_B", "XOR_OUT", "D_LATCH_DATA", "D_LATCH_ENABLE", "D_LATCH_OUT",
+		"DISABLED", "BLOCK_IN", "BLOCK_OUT",
+	};
+	static_assert(sizeof(names) / sizeof(names[0]) == (int)PinType::PIN_TYPE_COUNT);
+	return names[(int)type];
+}
+
+GateType getGateType(PinType type) {
+	switch (type)
+	{
+	case PinType::CONNECTOR:
+		return GateType::CONNECTOR;
+	case PinType::OUTPUT:
+		return GateType::OUTPUT;
+	case PinType::BUF_IN:
+	case PinType::BUF_OUT:
+		return GateType::BUF;
+	case PinType::NOT_IN:
+	case PinType::NOT_OUT:
+		return GateType::NOT;
+	case PinType::OR_A:
+	case PinType::OR_B:
+	case PinType::OR_OUT:
+		return GateType::OR;
+	case PinType::AND_A:
+	case PinType::AND_B:
+	case PinType::AND_OUT:
+		return GateType::AND;
+	case PinType::NOR_A:
+	case PinType::NOR_B:
+	case PinType::NOR_OUT:
+		return GateType::NOR;
+	case PinType::NAND_A:
+	case PinType::NAND_B:
+	case PinType::NAND_OUT:
+		return GateType::NAND;
+	case PinType::XOR_A:
+	case PinType::XOR_B:
+	case PinType::XOR_OUT:
+		return GateType::XOR;
+	case PinType::D_LATCH_DATA:
+	case PinType::D_LATCH_ENABLE:
+	case PinType::D_LATCH_OUT:
+		return GateType::D_LATCH;
+	default:
+		return GateType::CONNECTOR;
+	}
+}
+
+int getPinOffset(PinType type) {
+	switch (type)
+	{
+	case PinType::BUF_IN:
+	case PinType::NOT_IN:
+	case PinType::OR_B:
+	case PinType::AND_B:
+	case PinType::NOR_B:
+	case PinType::NAND_B:
+	case PinType::XOR_B:
+	case PinType::D_LATCH_ENABLE:
+		return 1;
+	case PinType::OR_A:
+	case PinType::AND_A:
+	case PinType::NOR_A:
+	case PinType::NAND_A:
+	case PinType::XOR_A:
+	case PinType::D_LATCH_DATA:
+		return 2;
+	case PinType::BUF_OUT:
+	case PinType::NOT_OUT:
+		return -1;
+	case PinType::OR_OUT:
+	case PinType::AND_OUT:
+	case PinType::NOR_OUT:
+	case PinType::NAND_OUT:
+	case PinType::XOR_OUT:
+	case PinType::D_LATCH_OUT:
+		return -2;
+	default:
+		return 0;
+	}
+}
+
+uint8_t getTruthTable(GateType type) {
+	//single input gates read the same pin as input a and b
+	switch (type)
+	{
+	case GateType::BUF:
+		return 0b11001100;
+	case GateType::NOT:
+		return 0b00110011;
+	case GateType::OR:
+		return 0b11101110;
+	case GateType::AND:
+		return 0b10001000;
+	case GateType::NOR:
+		return 0b00010001;
+	case GateType::NAND:
+		return 0b01110111;
+	case GateType::XOR:
+		return 0b01100110;
+	case GateType::D_LATCH:
+		//a is data, b is enable, keeps the old value when not enabled
+		return 0b11011000;
+	default:
+		return 0;
+	}
+}
+
+bool isDriver(PinType type) {
+	PinBaseType baseType = getPinBaseType(type);
+	return baseType == PinBaseType::OUTPUT || baseType == PinBaseType::BLOCK_OUTPUT || type == PinType::OUTPUT || type == PinType::DISABLED;
+}
+
+bool isReceiver(PinType type) {
+	PinBaseType baseType = getPinBaseType(type);
+	return baseType == PinBaseType::INPUT || baseType == PinBaseType::BLOCK_INPUT;
+}
@@ -19,13 +19,30 @@ enum class GateType : uint8_t {
 	NAND,
 	XOR,
 	D_LATCH,
+	//blocks, multi pin elements evaluated as a whole (see Block.h)
+	RAM,
+	WORD_ADD,
+	WORD_LATCH,
+	WORD_DECODER,
+	WORD_AND,
 	GATE_TYPE_COUNT,
 };
 
+enum class SimulationEngine : uint8_t {
+	//event driven with gate delays
+	EVENT,
+	//zero delay, evaluates the settled state in topological order
+	LEVELIZED,
+	//event driven with gate delays, partitioned over multiple threads
+	PARALLEL,
+};
+
 enum class PinBaseType : uint8_t {
 	CONNECTOR,
 	INPUT,
 	OUTPUT,
+	BLOCK_INPUT,
+	BLOCK_OUTPUT,
 };
 
 enum class PinType : uint8_t {
@@ -54,7 +71,28 @@ enum class PinType : uint8_t {
 	D_LATCH_ENABLE,
 	D_LATCH_OUT,
 	DISABLED,
+	BLOCK_IN,
+	BLOCK_OUT,
 	PIN_TYPE_COUNT,
 };
 
 PinBaseType getPinBaseType(PinType type);
+const char* getPinTypeName(PinType type);
+GateType getGateType(PinType type);
+//offset from an input pin to the gate output, or from an output pin to its first input
+int getPinOffset(PinType type);
+//output value indexed by (old output << 2) | (input a << 1) | input b
+uint8_t getTruthTable(GateType type);
+//drivers set the value of their net, receivers get events when it changes
+bool isDriver(PinType type);
+bool isReceiver(PinType type);
+
+//precomputed per pin information used by the simulation loop
+class PinDescriptor {
+public:
+	PinType type = PinType::DISABLED;
+	PinBaseType baseType = PinBaseType::CONNECTOR;
+	uint8_t truthTable = 0;
+	int8_t offset = 0;
+	int32_t delay = 0;
+};
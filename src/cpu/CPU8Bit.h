@@ -42,6 +42,17 @@ public:
 	const int addressBusSize = 16;
 	const int dataBusSize = 8;
 	int wordCount = 128;
+	//memory block instead of gate level memory cells
+	bool useRam = false;
+	//word level blocks instead of per bit gate networks, per subsystem (see Block.h)
+	//adders of the ALU and the PC incrementer
+	bool useWordAdders = false;
+	//register latches and their read enables
+	bool useWordRegisters = false;
+	//instruction decoding
+	bool useWordDecoders = false;
+	//enables in front of the shared buses
+	bool useWordEnables = false;
 
 	MemoryBank memory;
 	Pin clock;
@@ -89,7 +100,10 @@ public:
 		memory.addressBusSize = addressBusSize;
 		memory.dataBusSize = dataBusSize;
 		memory.wordCount = wordCount;
+		memory.useRam = useRam;
+		circuit->pushScope("memory");
 		memory.build();
+		circuit->popScope();
 
 		//buses
 		dataBus.create(circuit, dataBusSize);
@@ -108,9 +122,33 @@ public:
 		aluOpNot = builder.connector();
 		aluOpXor = builder.connector();
 
+		//scopes for Circuit::getScopeActivity
+		circuit->pushScope("registers");
 		buildRegisters();
+		circuit->popScope();
+		circuit->pushScope("control");
 		buildControlUnit();
+		circuit->popScope();
+		circuit->pushScope("alu");
 		buildALU();
+		circuit->popScope();
+	}
+
+	//buses in the scope "cpu", memory signals in "memory" and every register in its own scope
+	void addWaveforms(WaveformWriter& writer) {
+		writer.addSignal("cpu", "clock", clock);
+		writer.addSignal("cpu", "dataBus", dataBus);
+		writer.addSignal("cpu", "addressBus", addressBus);
+		writer.addSignal("cpu", "instBus", instBus);
+		writer.addSignal("cpu", "aluOut", aluOut);
+		writer.addSignal("memory", "clock", memory.clock);
+		writer.addSignal("memory", "read", memory.read);
+		writer.addSignal("memory", "write", memory.write);
+		writer.addSignal("memory", "addressBus", memory.addressBus);
+		writer.addSignal("memory", "dataBus", memory.dataBus);
+		for (int i = 0; i < registerCount; i++) {
+			registerByIndex[i]->addWaveforms(writer);
+		}
 	}
 
 	void buildRegisters() {
@@ -126,6 +164,9 @@ public:
 		registerByIndex[9] = &D;
 		registerByIndex[10] = &E;
 		registerByIndex[11] = &F;
+		for (int i = 0; i < registerCount; i++) {
+			registerByIndex[i]->useWordLatches = useWordRegisters;
+		}
 
 
 		pc.init(circuit, clock, pcWriteBus, addressBus);
@@ -189,8 +230,8 @@ public:
 
 		//fetch instruction
 		fetch.AND(fetch).connect(memory.read);
-		addressBus.AND(fetch).connect(memory.addressBus);
-		memory.dataBus.AND(fetch).connect(dataBus);
+		enable(addressBus, fetch).connect(memory.addressBus);
+		enable(memory.dataBus, fetch).connect(dataBus);
 		fetch.AND(fetch).AND(memory.clock).connect(inst.write);
 		fetch.AND(fetch).connect(pc.read);
 
@@ -198,19 +239,22 @@ public:
 
 		//increment PC
 		Bus zero;
-		zero.create(circuit, addressBusSize);
+		zero.circuit = circuit;
+		for (int i = 0; i < addressBusSize; i++) {
+			zero.addPin(builder.zero());
+		}
 		Bus incOut;
 		incOut.create(circuit, addressBusSize);
 		fullAdder(addressBus, zero, incOut, builder.one());
-		incOut.AND(fetch).connect(pcWriteBus);
+		enable(incOut, fetch).connect(pcWriteBus);
 		fetch.AND(fetch).connect(pc.write);
 
 
 
 		//decode instruction
-		inst.cell.AND(execute).connect(instBus);
-		Bus registerSelection = multiplexer(instBusL);
-		Bus opcodeSelection = multiplexer(instBusH);
+		enable(inst.cell, execute).connect(instBus);
+		Bus registerSelection = decoder(instBusL);
+		Bus opcodeSelection = decoder(instBusH);
 		Pin writeToSelectedRegister = builder.connector();
 		Pin readFromSelectedRegister = builder.connector();
 
@@ -233,11 +277,11 @@ public:
 		Pin op_not = opcodeSelection.getPin(11).AND(clock).AND(execute);
 		Pin op_xor = opcodeSelection.getPin(12).AND(clock).AND(execute);
 
-		instBusL.AND(op_ldl).connect(dataBusL);
-		accBusH.AND(op_ldl).connect(dataBusH);
+		enable(instBusL, op_ldl).connect(dataBusL);
+		enable(accBusH, op_ldl).connect(dataBusH);
 
-		instBusL.AND(op_ldh).connect(dataBusH);
-		accBusL.AND(op_ldh).connect(dataBusL);
+		enable(instBusL, op_ldh).connect(dataBusH);
+		enable(accBusL, op_ldh).connect(dataBusL);
 
 		op_ldl.OR(op_ldh).OR(op_ld.AND(memory.clock)).OR(op_mv_x).connect(acc.write);
 		op_st.OR(op_mv_acc).connect(acc.read);
@@ -245,25 +289,25 @@ public:
 		op_mv_acc.AND(op_mv_acc).connect(writeToSelectedRegister);
 
 		//special case: read and write PC
-		addressBus.split(0, 2).AND(pc.read.AND(execute)).connect(dataBus);
-		dataBus.AND(pc.write.AND(execute)).connect(pcWriteBus.split(0, 2));
+		enable(addressBus.split(0, 2), pc.read.AND(execute)).connect(dataBus);
+		enable(dataBus, pc.write.AND(execute)).connect(pcWriteBus.split(0, 2));
 
 		op_ld.AND(op_ld).connect(memory.read);
-		addressBus.AND(op_ld).connect(memory.addressBus);
-		memory.dataBus.AND(op_ld).connect(dataBus);
+		enable(addressBus, op_ld).connect(memory.addressBus);
+		enable(memory.dataBus, op_ld).connect(dataBus);
 
 		op_st.AND(op_st).connect(memory.write);
-		addressBus.AND(op_st).connect(memory.addressBus);
-		dataBus.AND(op_st).connect(memory.dataBus);
+		enable(addressBus, op_st).connect(memory.addressBus);
+		enable(dataBus, op_st).connect(memory.dataBus);
 
-		addrL.cell.AND(op_ld.OR(op_st)).connect(addressBus.split(0, 2));
-		addrH.cell.AND(op_ld.OR(op_st)).connect(addressBus.split(1, 2));
+		enable(addrL.cell, op_ld.OR(op_st)).connect(addressBus.split(0, 2));
+		enable(addrH.cell, op_ld.OR(op_st)).connect(addressBus.split(1, 2));
 
 
 		//arithmetic
 		Pin accWriteFromAlu = builder.connector();
-		dataBus.AND(accWriteFromAlu.NOT()).connect(accWriteBus);
-		aluOut.AND(accWriteFromAlu).connect(accWriteBus);
+		enable(dataBus, accWriteFromAlu.NOT()).connect(accWriteBus);
+		enable(aluOut, accWriteFromAlu).connect(accWriteBus);
 
 		op_add.AND(op_add).connect(aluOpAdd);
 		op_sub.AND(op_sub).connect(aluOpSub);
@@ -276,8 +320,8 @@ public:
 		any_alu.AND(any_alu).connect(acc.write);
 		any_alu.AND(any_alu).connect(readFromSelectedRegister);
 
-		acc.cell.AND(any_alu.AND(any_alu)).connect(aluInA);
-		dataBus.AND(any_alu.AND(any_alu)).connect(aluInB);
+		enable(acc.cell, any_alu.AND(any_alu)).connect(aluInA);
+		enable(dataBus, any_alu.AND(any_alu)).connect(aluInB);
 
 		auto op_halt = opcodeSelection.getPin(0).AND(clock).AND(execute).AND(registerSelection.getPin(1));
 		dLatch(op_halt, clock.AND(execute)).connect(halt_signal);
@@ -289,13 +333,13 @@ public:
 		Bus addOut;
 		addOut.create(circuit, dataBusSize);
 		fullAdder(aluInA, aluInB, addOut, builder.zero());
-		addOut.AND(aluOpAdd).connect(aluOut);
+		enable(addOut, aluOpAdd).connect(aluOut);
 
 		//sub
 		Bus subOut;
 		subOut.create(circuit, dataBusSize);
 		fullAdder(aluInA, aluInB, subOut, builder.zero());
-		subOut.AND(aluOpSub).connect(aluOut);
+		enable(subOut, aluOpSub).connect(aluOut);
 
 		//AND
 		Bus andOut;
@@ -303,7 +347,7 @@ public:
 		for (int i = 0; i < aluInA.size(); i++) {
 			aluInA.getPin(i).AND(aluInB.getPin(i)).connect(andOut.getPin(i));
 		}
-		andOut.AND(aluOpAnd).connect(aluOut);
+		enable(andOut, aluOpAnd).connect(aluOut);
 
 		//OR
 		Bus orOut;
@@ -311,7 +355,7 @@ public:
 		for (int i = 0; i < aluInA.size(); i++) {
 			aluInA.getPin(i).OR(aluInB.getPin(i)).connect(orOut.getPin(i));
 		}
-		orOut.AND(aluOpOr).connect(aluOut);
+		enable(orOut, aluOpOr).connect(aluOut);
 
 		//NOT
 		Bus notOut;
@@ -319,7 +363,7 @@ public:
 		for (int i = 0; i < aluInA.size(); i++) {
 			aluInA.getPin(i).NOT().connect(notOut.getPin(i));
 		}
-		notOut.AND(aluOpNot).connect(aluOut);
+		enable(notOut, aluOpNot).connect(aluOut);
 
 		//XOR
 		Bus xorOut;
@@ -327,10 +371,17 @@ public:
 		for (int i = 0; i < aluInA.size(); i++) {
 			aluInA.getPin(i).XOR(aluInB.getPin(i)).connect(xorOut.getPin(i));
 		}
-		xorOut.AND(aluOpXor).connect(aluOut);
+		enable(xorOut, aluOpXor).connect(aluOut);
 	}
 
 	Pin fullAdder(Bus& aBus, Bus& bBus, Bus& outBus, Pin carry) {
+		if (useWordAdders) {
+			Bus sum = wordAdder(aBus, bBus, carry);
+			for (int i = 0; i < aBus.size(); i++) {
+				sum.getPin(i).connect(outBus.getPin(i));
+			}
+			return sum.getPin(aBus.size());
+		}
 		for (int i = 0; i < aBus.size(); i++) {
 			auto a = aBus.getPin(i);
 			auto b = bBus.getPin(i);
@@ -342,4 +393,18 @@ public:
 		return carry;
 	}
 
+	Bus decoder(Bus select) {
+		circuit->pushScope("decode");
+		Bus output = useWordDecoders ? wordDecoder(select) : multiplexer(select);
+		circuit->popScope();
+		return output;
+	}
+
+	Bus enable(Bus bus, Pin signal) {
+		if (useWordEnables) {
+			return wordAnd(bus, signal);
+		}
+		return bus.AND(signal);
+	}
+
 };
@@ -14,6 +14,10 @@ public:
 	int addressBusSize = 16;
 	int dataBusSize = 8;
 	int wordCount = 1024;
+	//one behavioral memory block instead of gate level cells, the cost per access does not grow with the size
+	bool useRam = false;
+	//gate level words as instances of one module, the lines of a word are stored once
+	bool useModules = false;
 
 	Bus dataBus;
 	Bus addressBus;
@@ -25,10 +29,61 @@ public:
 	std::vector<Bus> cells;
 	Bus internalReadBus;
 	Bus internalWriteBus;
+	//first pin of the memory block
+	Index ram = -1;
+	Index wordModule = -1;
 
 	void build() {
 		buildBase();
-		buildCells();
+		if (useRam) {
+			buildRam();
+		}
+		else {
+			buildCells();
+		}
+	}
+
+	void buildRam() {
+		cells.clear();
+		ram = circuit->addRam(addressBusSize, dataBusSize, wordCount);
+
+		Index pin = ram;
+		for (int i = 0; i < addressBusSize; i++) {
+			addressBus.getPin(i).connect(Pin(circuit, pin++));
+		}
+		for (int i = 0; i < dataBusSize; i++) {
+			internalWriteBus.getPin(i).connect(Pin(circuit, pin++));
+		}
+		read.connect(Pin(circuit, pin++));
+		write.connect(Pin(circuit, pin++));
+		clock.connect(Pin(circuit, pin++));
+		for (int i = 0; i < dataBusSize; i++) {
+			Pin(circuit, pin++).connect(internalReadBus.getPin(i));
+		}
+	}
+
+	//word access from outside the simulation, works with cells and with the memory block
+	uint64_t getWord(int index) {
+		if (!useRam) {
+			return cells[index].getValue();
+		}
+		uint8_t* word = circuit->getBlockMemory(ram) + (int64_t)index * ((dataBusSize + 7) / 8);
+		uint64_t value = 0;
+		for (int i = 0; i < (dataBusSize + 7) / 8; i++) {
+			value |= (uint64_t)word[i] << (i * 8);
+		}
+		return value;
+	}
+
+	void setWord(int index, uint64_t value) {
+		if (!useRam) {
+			cells[index].setValue(value);
+			return;
+		}
+		uint8_t* word = circuit->getBlockMemory(ram) + (int64_t)index * ((dataBusSize + 7) / 8);
+		for (int i = 0; i < (dataBusSize + 7) / 8; i++) {
+			word[i] = value >> (i * 8);
+		}
 	}
 
 	void buildBase(bool useInternalBus = false) {
@@ -110,7 +165,18 @@ public:
 			isCell = true;
 		}
 
-		if (isCell) {
+		if (isCell && useModules) {
+			if (wordModule == -1) {
+				wordModule = buildWordModule();
+			}
+			SubCircuit word = circuit->addInstance(wordModule);
+			inBus.connect(word.buses["in"]);
+			word.buses["out"].connect(outBus);
+			read.connect(word.pins["read"]);
+			write.connect(word.pins["write"]);
+			cells.push_back(word.buses["cell"]);
+		}
+		else if (isCell) {
 			cells.emplace_back();
 			Bus& cell = cells.back();
 			cell.circuit = circuit;
@@ -143,9 +209,30 @@ public:
 		}
 	}
 
+	//one word of addBank_v2 as a module
+	Index buildWordModule() {
+		Circuit definition;
+		Bus in = definition.bus(dataBusSize);
+		Bus out = definition.bus(dataBusSize);
+		Bus read = definition.bus(1);
+		Bus write = definition.bus(1);
+		Bus cell;
+		cell.circuit = &definition;
+
+		for (int i = 0; i < dataBusSize; i++) {
+			auto q = dLatch(in.getPin(i), write.getPin(0));
+			q.AND(read.getPin(0)).connect(out.getPin(i));
+			cell.addPin(q);
+		}
+		return circuit->addModule("memory word " + std::to_string(dataBusSize), definition, {
+			{ "in", in }, { "out", out }, { "read", read }, { "write", write }, { "cell", cell },
+		});
+	}
+
 	void buildCells_v2() {
 		auto builder = Pin(circuit);
 		cells.clear();
+		wordModule = -1;
 
 		int level = std::min((int)std::log2(wordCount) + 1, addressBusSize - 1);
 		addBank_v2(level, clock.AND(read), clock.AND(write), internalWriteBus, internalReadBus);
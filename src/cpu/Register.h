@@ -19,6 +19,8 @@ public:
 	Bus outBus;
 	Pin read;
 	Pin write;
+	//word level latch and read enable blocks instead of per bit gates
+	bool useWordLatches = false;
 
 	Register() {
 
@@ -43,6 +45,12 @@ public:
 		write = builder.connector();
 		cell.circuit = circuit;
 
+		if (useWordLatches) {
+			cell = wordLatch(inBus, write.AND(clock));
+			wordAnd(cell, read.AND(clock)).connect(outBus);
+			return;
+		}
+
 		for (int i = 0; i < inBus.size(); i++) {
 			auto inPin = inBus.getPin(i);
 			auto outPin = outBus.getPin(i);
@@ -54,6 +62,16 @@ public:
 		}
 	}
 
+	//cell and control signals in a scope named after the register
+	void addWaveforms(WaveformWriter& writer) {
+		writer.addSignal(name, "cell", cell);
+		if (bufferCell.size() > 0) {
+			writer.addSignal(name, "buffer", bufferCell);
+		}
+		writer.addSignal(name, "read", read);
+		writer.addSignal(name, "write", write);
+	}
+
 	void buildBuffered() {
 		Pin builder = Pin(circuit);
 
@@ -62,6 +80,13 @@ public:
 		cell.circuit = circuit;
 		bufferCell.circuit = circuit;
 
+		if (useWordLatches) {
+			bufferCell = wordLatch(inBus, write.AND(clock));
+			cell = wordLatch(bufferCell, clock.NOT());
+			wordAnd(cell, read.AND(clock)).connect(outBus);
+			return;
+		}
+
 		for (int i = 0; i < inBus.size(); i++) {
 			auto inPin = inBus.getPin(i);
 			auto outPin = outBus.getPin(i);
@@ -0,0 +1,356 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#pragma once
+
+#include "cpu/CPU8Bit.h"
+#include <string>
+#include <map>
+#include <algorithm>
+
+//builds the cpu and runs assembly programs on it, used by the cpu demos and the benchmarks
+class CPUTester {
+public:
+	Circuit circuit;
+	CPU8Bit cpu;
+
+	std::map<std::string, int> instructionMap;
+
+	Pin clock;
+	Pin memoryClock;
+	//each clock phase runs until the cpu settled, a phase that needs more than maxTimeUnitsPerPhase counts as unsettled
+	bool settle = true;
+	int maxTimeUnitsPerPhase = 1000;
+	int unsettledPhases = 0;
+	//longest phase so far
+	int maxPhaseTimeUnits = 0;
+	//fixed time per phase without settle, this can cut phases short: the longest phases take 31, 35 and 41 units
+	//at D_LATCH delays of 1, 3 and 6 (see testSettle), use settle and maxTimeUnitsPerPhase to run phases until they settled
+	int timeUnitsPerClockCycle = 26;
+	int timeUnitsSpentTotal = 0;
+	int clockCyclesTotal = 0;
+	int instructionsTotal = 0;
+	bool optimize = false;
+
+	void build() {
+		buildCircuit();
+		circuit.prepare();
+	}
+
+	//everything but prepare
+	void buildCircuit() {
+		cpu.circuit = &circuit;
+
+		cpu.build();
+
+		auto builder = Pin(&circuit);
+		clock = builder.input();
+		memoryClock = builder.input();
+		clock.connect(cpu.clock);
+		memoryClock.connect(cpu.memory.clock);
+
+		if (optimize) {
+			circuit.optimize();
+		}
+
+		instructionMap["NOOP"] = 0x00;
+		instructionMap["HALT"] = 0x01;
+
+		for (int i = 0; i < 16; i++) {
+			instructionMap[std::string("LDL ") + std::to_string(i)] = 0x10 + i;
+			instructionMap[std::string("LDH ") + std::to_string(i)] = 0x20 + i;
+		}
+
+		instructionMap["LD"] = 0x30;
+		instructionMap["ST"] = 0x40;
+
+		std::vector<std::string> registerNames = {
+			"PC", "INST", "FLAG", "ACC", "ADDRL", "ADDRH", "A", "B", "C", "D", "E", "F",
+		};
+		for (int i = 0; i < registerNames.size(); i++) {
+			auto name = registerNames[i];
+			instructionMap[std::string("MV ACC ") + name] = 0x50 + i;
+			instructionMap[std::string("MV ") + name + " ACC"] = 0x60 + i;
+			instructionMap[std::string("ADD ") + name] = 0x70 + i;
+			instructionMap[std::string("SUB ") + name] = 0x80 + i;
+			instructionMap[std::string("AND ") + name] = 0x90 + i;
+			instructionMap[std::string("OR ") + name] = 0xa0 + i;
+			instructionMap[std::string("XOR ") + name] = 0xc0 + i;
+		}
+
+		instructionMap["NOT"] = 0xb3;
+		instructionMap["NOT ACC"] = 0xb3;
+	}
+
+	void sim() {
+		if (!settle) {
+			timeUnitsSpentTotal += circuit.simulate(timeUnitsPerClockCycle);
+			return;
+		}
+		int timeNeeded = circuit.settle(maxTimeUnitsPerPhase);
+		if (timeNeeded == -1) {
+			unsettledPhases++;
+			timeNeeded = maxTimeUnitsPerPhase;
+		}
+		maxPhaseTimeUnits = std::max(maxPhaseTimeUnits, timeNeeded);
+		timeUnitsSpentTotal += timeNeeded;
+	}
+
+	void tick(bool print = false) {
+		clock.setValue(0);
+		sim();
+		
+		//fetch
+		clock.setValue(1);
+		sim();
+
+		memoryClock.setValue(1);
+		sim();
+
+		memoryClock.setValue(0);
+		sim();
+
+		clock.setValue(0);
+		sim();
+
+		//execute
+		clock.setValue(1);
+		sim();
+
+		memoryClock.setValue(1);
+		sim();
+
+		if (print) {
+			printState();
+		}
+
+		memoryClock.setValue(0);
+		sim();
+
+		clock.setValue(0);
+		sim();
+
+		instructionsTotal++;
+		clockCyclesTotal += 2;
+	}
+
+	void printBus(Bus& bus, const std::string& name) {
+		printf("%s:\t  %s (0x%02X)\n", name.c_str(), bus.getStrValue().c_str(), (int)bus.getValue());
+	}
+
+	void printState(int memoryCellCount = 8) {
+		printBus(cpu.memory.dataBus, "mem data bus");
+		printBus(cpu.memory.addressBus, "mem addr bus");
+		printBus(cpu.dataBus, "data bus");
+		printBus(cpu.addressBus, "addr bus");
+
+		printBus(cpu.instBus, "instruction bus");
+
+
+		for (int i = 0; i < cpu.registerCount; i++) {
+			auto& reg = *cpu.registerByIndex[i];
+			auto& cell = reg.cell;
+		
+			if (reg.name == "inst") {
+				printf("%s:\t  %s (0x%02X) %s\n", reg.name.c_str(), cell.getStrValue().c_str(), (int)cell.getValue(), instructionFromCode(cell.getValue()).c_str());
+			}
+			else if (reg.name == "acc" || reg.name == "pc") {
+				auto& buffer = reg.bufferCell;
+				printf("%s:\t  %s (0x%02X)\n", reg.name.c_str(), buffer.getStrValue().c_str(), (int)buffer.getValue());
+			}
+			else {
+				printf("%s:\t  %s (0x%02X)\n", reg.name.c_str(), cell.getStrValue().c_str(), (int)cell.getValue());
+			}
+		}
+
+		printBus(cpu.aluInA, "alu A");
+		printBus(cpu.aluInB, "alu B");
+		printBus(cpu.aluOut, "alu O");
+
+		memoryCellCount = std::min(memoryCellCount, cpu.memory.wordCount);
+		for (int i = 0; i < memoryCellCount; i++) {
+			int word = cpu.memory.getWord(i);
+			std::string bits;
+			for (int k = cpu.dataBusSize - 1; k >= 0; k--) {
+				bits += (word >> k) & 1 ? "1" : "0";
+			}
+			printf("mem[0x%02X]:   %s (0x%02X)\n", i, bits.c_str(), word);
+		}
+
+		printf("\n");
+	}
+
+	//registers followed by every memory word, runs of the same program compare equal
+	std::vector<uint64_t> getState() {
+		std::vector<uint64_t> state;
+		for (int i = 0; i < cpu.registerCount; i++) {
+			state.push_back(cpu.registerByIndex[i]->cell.getValue());
+		}
+		for (int i = 0; i < cpu.memory.wordCount; i++) {
+			state.push_back(cpu.memory.getWord(i));
+		}
+		return state;
+	}
+
+	//words only one of the cpus has have to be zero
+	bool sameState(CPUTester& other) {
+		std::vector<uint64_t> a = getState();
+		std::vector<uint64_t> b = other.getState();
+		a.resize(std::max(a.size(), b.size()), 0);
+		b.resize(a.size(), 0);
+		return a == b;
+	}
+
+	std::vector<std::string> strSplit(const std::string& string, const std::string& delimiter, bool includeEmpty = false) {
+		std::vector<std::string> parts;
+		std::string token;
+		int delimiterIndex = 0;
+		for (char c : string) {
+			if ((int)delimiter.size() == 0) {
+				parts.push_back({ c, 1 });
+			}
+			else if (c == delimiter[delimiterIndex]) {
+				delimiterIndex++;
+				if (delimiterIndex == delimiter.size()) {
+					if (includeEmpty || (int)token.size() != 0) {
+						parts.push_back(token);
+					}
+					token.clear();
+					delimiterIndex = 0;
+				}
+			}
+			else {
+				token += delimiter.substr(0, delimiterIndex);
+				token.push_back(c);
+				delimiterIndex = 0;
+			}
+		}
+		token += delimiter.substr(0, delimiterIndex);
+		if (includeEmpty || (int)token.size() != 0) {
+			parts.push_back(token);
+		}
+		return parts;
+	}
+
+	std::string instructionFromCode(int code) {
+		for (auto& i : instructionMap) {
+			if (i.second == code) {
+				return i.first;
+			}
+		}
+		return "";
+	}
+
+	int codeFomrInstruction(const std::string& str) {
+		if (instructionMap.contains(str)) {
+			return instructionMap[str];
+		}
+		return 0x00;
+	}
+
+	std::vector<int> assemble(const std::string& code) {
+		std::vector<int> bytes;
+		auto lines = strSplit(code, "\n", false);
+		for (auto& line : lines) {
+			int byte = codeFomrInstruction(line);
+			if (byte != 0 || line == "NOOP") {
+				bytes.push_back(byte);
+			}
+		}
+		return bytes;
+	}
+
+	void loadProgram(const std::string& code, int memoryOffset) {
+		cpu.pc.cell.setValue(memoryOffset);
+		for (int byte : assemble(code)) {
+			if (cpu.memory.wordCount > memoryOffset) {
+				cpu.memory.setWord(memoryOffset++, byte);
+			}
+		}
+	}
+
+	void run(bool print, int maxCycles = 1024) {
+		for (int i = 0; i < maxCycles; i++) {
+			tick(print);
+			if (cpu.inst.cell.getValue() == 0x1) {
+				//HALT
+				break;
+			}
+		}
+	}
+
+	//the same clock sequence as tick, but generated by the engine and run in a single simulate call
+	//a phase needs timeUnitsPerPhase to settle, stops at HALT like run
+	void runClocked(int maxCycles, int timeUnitsPerPhase) {
+		int instructionTime = 8 * timeUnitsPerPhase;
+		circuit.addClock(clock, 4 * timeUnitsPerPhase, 3 * timeUnitsPerPhase, timeUnitsPerPhase);
+		circuit.addClock(memoryClock, 4 * timeUnitsPerPhase, timeUnitsPerPhase, 2 * timeUnitsPerPhase);
+		circuit.addStopCondition(cpu.inst.cell, 0x1);
+
+		int64_t startTime = circuit.getSimulationTime();
+		circuit.simulate(maxCycles * instructionTime);
+		//the stop lies within the HALT instruction, which is finished like run does
+		int instructions = (circuit.getSimulationTime() - startTime + instructionTime - 1) / instructionTime;
+		circuit.removeStopConditions();
+		if (circuit.isStopped()) {
+			circuit.simulate(startTime + (int64_t)instructions * instructionTime - circuit.getSimulationTime());
+		}
+		//the last clock edge lies on the end of the run, its events still need to settle
+		circuit.removeClocks();
+		circuit.settle(maxTimeUnitsPerPhase);
+
+		timeUnitsSpentTotal += circuit.getSimulationTime() - startTime;
+		instructionsTotal += instructions;
+		clockCyclesTotal += 2 * instructions;
+	}
+
+	void printInfo() {
+		printf("memory: %i bit (%i byte)\n", cpu.memory.wordCount * cpu.memory.dataBusSize, (cpu.memory.wordCount * cpu.memory.dataBusSize) / 8);
+		printf("data bus: %i bit\n", cpu.dataBusSize);
+		printf("address bus: %i bit\n", cpu.addressBusSize);
+
+		printf("gates: %i\n", circuit.getGateCount());
+		printf("lines: %i\n", circuit.getLineCount());
+		printf("pins:  %i\n", circuit.getPinCount());
+
+		printf("transistors: %i\n", circuit.getGateCount() * 2);
+		printf("\n");
+	}
+};
+
+static const char* testProgram = R"(
+LDL 3
+LDH 6
+MV ACC A
+LDL 1
+LDH 1
+MV ACC B
+LDH 2
+LDL 0
+MV ACC ADDRL
+
+LDL 1
+LDH 0
+ADD ADDRL
+MV ACC ADDRL
+MV C ACC
+ADD A
+MV ACC C
+ST
+LDL 1
+LDH 0
+ADD ADDRL
+MV ACC ADDRL
+MV C ACC
+ADD B
+MV ACC C
+ST
+
+# jump
+LDL 13
+LDH 14
+ADD PC
+MV ACC PC
+HALT
+)";
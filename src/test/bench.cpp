@@ -0,0 +1,304 @@
+//
+// Copyright (c) 2023 Julian Hinxlage. All rights reserved.
+//
+
+#include "CPUTester.h"
+#include "util/Clock.h"
+#include "core/elements.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+
+//benchmarks on circuits of growing size, the results are written as json to compare them between commits
+//usage: bench [output file] [repeat count]
+//build, prepare and simulate are timed separately, the fastest of the repeated runs is kept
+
+class BenchResult {
+public:
+	std::string workload;
+	int size = 0;
+	int gates = 0;
+	int pins = 0;
+	int64_t lines = 0;
+	double build = 0;
+	double prepare = 0;
+	double simulate = 0;
+	int64_t events = 0;
+	int64_t simulatedTime = 0;
+	bool valid = true;
+
+	std::string toJson() const {
+		char buffer[512];
+		snprintf(buffer, sizeof(buffer),
+			"{\"workload\": \"%s\", \"size\": %i, \"gates\": %i, \"pins\": %i, \"lines\": %lli, "
+			"\"build\": %.6f, \"prepare\": %.6f, \"simulate\": %.6f, \"events\": %lli, \"simulatedTime\": %lli, "
+			"\"eventsPerSecond\": %.0f, \"result\": \"%s\"}",
+			workload.c_str(), size, gates, pins, (long long)lines, build, prepare, simulate, (long long)events,
+			(long long)simulatedTime, simulate > 0 ? events / simulate : 0, valid ? "OK" : "FAIL");
+		return buffer;
+	}
+};
+
+//the same inputs on every run
+static uint64_t benchRandom(uint64_t& seed) {
+	seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+	return seed >> 16 ^ seed << 32;
+}
+
+//fills in the circuit size and the engine counters after the simulation
+static void finishResult(BenchResult& result, Circuit& circuit) {
+	result.gates = circuit.getGateCount();
+	result.pins = circuit.getPinCount();
+	result.lines = circuit.getLineCount();
+	const SimulationStats& stats = circuit.getStats();
+	result.events = stats.events;
+	result.simulatedTime = stats.simulatedTime;
+}
+
+//ripple carry adder of CPU8Bit::fullAdder, adds random numbers
+BenchResult benchAdder(int bits) {
+	BenchResult result;
+	Circuit circuit;
+	Clock clock;
+
+	CPU8Bit cpu;
+	cpu.circuit = &circuit;
+	Bus a;
+	Bus b;
+	Bus sum;
+	a.createInput(&circuit, bits);
+	b.createInput(&circuit, bits);
+	sum.create(&circuit, bits);
+	cpu.fullAdder(a, b, sum, Pin(&circuit).zero());
+	result.build = clock.round();
+
+	circuit.prepare();
+	result.prepare = clock.round();
+
+	uint64_t mask = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+	uint64_t seed = 1;
+	for (int i = 0; i < 1000; i++) {
+		uint64_t valueA = benchRandom(seed) & mask;
+		uint64_t valueB = benchRandom(seed) & mask;
+		a.setValue(valueA);
+		b.setValue(valueB);
+		circuit.simulate();
+		if (sum.getValue() != ((valueA + valueB) & mask)) {
+			result.valid = false;
+		}
+	}
+	result.simulate = clock.round();
+	finishResult(result, circuit);
+	return result;
+}
+
+//selects every output of a multiplexer once
+BenchResult benchDecoder(int bits) {
+	BenchResult result;
+	Circuit circuit;
+	Clock clock;
+
+	Bus select;
+	select.createInput(&circuit, bits);
+	Bus output = multiplexer(select);
+	result.build = clock.round();
+
+	circuit.prepare();
+	result.prepare = clock.round();
+
+	for (int i = 0; i < (1 << bits); i++) {
+		select.setValue(i);
+		circuit.simulate();
+		if (!output.getPin(i).getValue() || (i > 0 && output.getPin(i - 1).getValue())) {
+			result.valid = false;
+		}
+	}
+	result.simulate = clock.round();
+	finishResult(result, circuit);
+	return result;
+}
+
+//ripple counter of tLatch stages, counts clock pulses, the pulses grow with the stages to keep the work per stage
+BenchResult benchCounter(int bits) {
+	BenchResult result;
+	Circuit circuit;
+	Clock clock;
+
+	Pin toggle = Pin(&circuit).input();
+	Bus counter;
+	counter.circuit = &circuit;
+	Pin stage = toggle;
+	for (int i = 0; i < bits; i++) {
+		stage = tLatch(stage);
+		counter.addPin(stage);
+	}
+	result.build = clock.round();
+
+	circuit.prepare();
+	result.prepare = clock.round();
+
+	uint64_t mask = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+	uint64_t start = counter.getValue();
+	int pulses = bits * 64;
+	for (int i = 0; i < pulses; i++) {
+		toggle.setValue(true);
+		circuit.simulate();
+		toggle.setValue(false);
+		circuit.simulate();
+	}
+	//the stages count down
+	if (((start - counter.getValue()) & mask) != (pulses & mask)) {
+		result.valid = false;
+	}
+	result.simulate = clock.round();
+	finishResult(result, circuit);
+	return result;
+}
+
+//gate level memory, writes every word and reads it back
+BenchResult benchMemory(int addressBits) {
+	BenchResult result;
+	Circuit circuit;
+	Clock clock;
+
+	MemoryBank memory;
+	memory.circuit = &circuit;
+	memory.wordCount = 1 << addressBits;
+	memory.build();
+	result.build = clock.round();
+
+	circuit.prepare();
+	result.prepare = clock.round();
+
+	for (int pass = 0; pass < 2; pass++) {
+		bool write = pass == 0;
+		if (!write) {
+			memory.dataBus.setValue(0);
+		}
+		for (int i = 0; i < memory.wordCount; i++) {
+			memory.addressBus.setValue(i);
+			if (write) {
+				memory.dataBus.setValue((i * 37) & 0xff);
+			}
+			memory.write.setValue(write);
+			memory.read.setValue(!write);
+
+			memory.clock.setValue(false);
+			circuit.simulate();
+			memory.clock.setValue(true);
+			circuit.simulate();
+			if (!write && memory.dataBus.getValue() != ((i * 37) & 0xff)) {
+				result.valid = false;
+			}
+			memory.clock.setValue(false);
+			circuit.simulate();
+		}
+	}
+	result.simulate = clock.round();
+	finishResult(result, circuit);
+	return result;
+}
+
+//registers after 1000 instructions of testProgram, 49 passes of the loop and 11 instructions into the next
+static const std::vector<std::pair<std::string, uint64_t>> testProgramRegisters = {
+	{ "pc", 0x14 }, { "inst", 0x74 }, { "flag", 0x00 }, { "acc", 0x84 }, { "addrL", 0x83 }, { "addrH", 0x00 },
+	{ "A", 0x63 }, { "B", 0x11 }, { "C", 0x97 }, { "D", 0x00 }, { "E", 0x00 }, { "F", 0x00 },
+};
+
+//the program of testCPU with the given memory size, checked against the known registers
+BenchResult benchCPU(int wordCount) {
+	BenchResult result;
+	CPUTester tester;
+	Clock clock;
+
+	tester.cpu.wordCount = wordCount;
+	tester.buildCircuit();
+	result.build = clock.round();
+
+	tester.circuit.prepare();
+	tester.circuit.setGateDelay(GateType::D_LATCH, 3);
+	tester.circuit.setSimulationMode(false);
+	result.prepare = clock.round();
+
+	tester.loadProgram(testProgram, 0);
+	tester.circuit.resetStats();
+	clock.reset();
+	tester.run(false, 1000);
+	result.simulate = clock.round();
+
+	if (tester.cpu.registerCount != testProgramRegisters.size()) {
+		result.valid = false;
+	}
+	for (int i = 0; i < tester.cpu.registerCount && i < testProgramRegisters.size(); i++) {
+		auto& reg = *tester.cpu.registerByIndex[i];
+		if (reg.name != testProgramRegisters[i].first || reg.cell.getValue() != testProgramRegisters[i].second) {
+			result.valid = false;
+		}
+	}
+	finishResult(result, tester.circuit);
+	return result;
+}
+
+int main(int argc, char* argv[]) {
+	std::string file = argc > 1 ? argv[1] : "";
+	int repeat = argc > 2 ? std::max(atoi(argv[2]), 1) : 3;
+
+	class Workload {
+	public:
+		const char* name;
+		BenchResult(*function)(int size);
+		std::vector<int> sizes;
+	};
+	std::vector<Workload> workloads = {
+		{ "adder", benchAdder, { 8, 16, 32, 64 } },
+		{ "decoder", benchDecoder, { 4, 8, 10 } },
+		{ "counter", benchCounter, { 8, 16, 32 } },
+		{ "memory", benchMemory, { 6, 8, 10 } },
+		{ "cpu", benchCPU, { 128, 1024 } },
+	};
+
+	std::vector<BenchResult> results;
+	for (auto& workload : workloads) {
+		for (int size : workload.sizes) {
+			BenchResult best;
+			for (int run = 0; run < repeat; run++) {
+				BenchResult result = workload.function(size);
+				if (run == 0) {
+					best = result;
+				}
+				best.build = std::min(best.build, result.build);
+				best.prepare = std::min(best.prepare, result.prepare);
+				best.simulate = std::min(best.simulate, result.simulate);
+				best.valid = best.valid && result.valid;
+			}
+			best.workload = workload.name;
+			best.size = size;
+			results.push_back(best);
+			fprintf(stderr, "%-8s %6i: build %fs, prepare %fs, simulate %fs, result: %s\n",
+				best.workload.c_str(), size, best.build, best.prepare, best.simulate, best.valid ? "OK" : "FAIL");
+		}
+	}
+
+	FILE* output = stdout;
+	if (!file.empty()) {
+		output = fopen(file.c_str(), "w");
+		if (!output) {
+			fprintf(stderr, "could not open %s\n", file.c_str());
+			return 1;
+		}
+	}
+	fprintf(output, "{\n\t\"repeat\": %i,\n\t\"results\": [\n", repeat);
+	for (int i = 0; i < results.size(); i++) {
+		fprintf(output, "\t\t%s%s\n", results[i].toJson().c_str(), i + 1 < results.size() ? "," : "");
+	}
+	fprintf(output, "\t]\n}\n");
+	if (output != stdout) {
+		fclose(output);
+	}
+
+	bool valid = true;
+	for (auto& result : results) {
+		valid = valid && result.valid;
+	}
+	return valid ? 0 : 1;
+}
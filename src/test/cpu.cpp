@@ -2,304 +2,491 @@
 // Copyright (c) 2023 Julian Hinxlage. All rights reserved.
 //
 
-#include "cpu/CPU8Bit.h"
+#include "CPUTester.h"
 #include "util/Clock.h"
+#include "core/SimulationFarm.h"
 #include <string>
+#include <thread>
+#include <filesystem>
 
-class CPUTester {
-public:
-	Circuit circuit;
-	CPU8Bit cpu;
-
-	std::map<std::string, int> instructionMap;
-
-	Pin clock;
-	Pin memoryClock;
-	//currently 22 needed (26 for sorted)
-	int timeUnitsPerClockCycle = 26;
-	int timeUnitsSpentTotal = 0;
-	int clockCyclesTotal = 0;
-	int instructionsTotal = 0;
-
-	void build() {
-		cpu.circuit = &circuit;
+void testCPU(SimulationEngine engine) {
+	CPUTester tester;
+	tester.cpu.wordCount = 256;
 
-		cpu.build();
+	tester.build();
+	tester.circuit.setGateDelay(GateType::D_LATCH, 3);
+	tester.circuit.setSimulationMode(false);
+	tester.circuit.setThreadCount(std::thread::hardware_concurrency());
+	tester.circuit.setSimulationEngine(engine);
 
-		auto builder = Pin(&circuit);
-		clock = builder.input();
-		memoryClock = builder.input();
-		clock.connect(cpu.clock);
-		memoryClock.connect(cpu.memory.clock);
+	tester.printInfo();
 
-		circuit.prepare();
+	Clock clock;
 
+	tester.loadProgram(testProgram, 0);
+	tester.circuit.resetStats();
 
-		instructionMap["NOOP"] = 0x00;
-		instructionMap["HALT"] = 0x01;
+	clock.reset();
+	tester.run(false, 2000);
+	tester.printState(64);
+	
+	float time = clock.elapsed();
+	printf("took %fs\n", time);
+	printf("time units spent: %i\n", tester.timeUnitsSpentTotal);
+	printf("sim time: %i\n", tester.circuit.getSimulationTime());
+	printf("clock cycles: %i\n", tester.clockCyclesTotal);
+	printf("instructions: %i\n", tester.instructionsTotal);
+	printf("speed: %.3f kH\n", (tester.clockCyclesTotal / time) / 1000);
+	//the levelized engine has no time units, it settles each phase in sweeps
+	if (engine == SimulationEngine::LEVELIZED) {
+		const SimulationStats& stats = tester.circuit.getStats();
+		printf("sweeps per instruction: %lli\n", (long long)(stats.sweeps / tester.instructionsTotal));
+		printf("evaluations per instruction: %lli\n", (long long)(stats.evaluations / tester.instructionsTotal));
+	}
+	else {
+		printf("unit took: %.0f ns\n", (time / tester.timeUnitsSpentTotal) * 1000 * 1000 * 1000);
+		printf("units per instruction: %i\n", tester.timeUnitsSpentTotal / tester.instructionsTotal);
+		printf("sim time units per instruction: %i\n", tester.circuit.getSimulationTime() / tester.instructionsTotal);
+		printf("events per instruction: %lli\n", (long long)(tester.circuit.getQueuedEventCount() / tester.instructionsTotal));
+	}
+	printf("unsettled phases: %i\n", tester.unsettledPhases);
+	printf("stats: ");
+	tester.circuit.dumpStats();
+}
 
-		for (int i = 0; i < 16; i++) {
-			instructionMap[std::string("LDL ") + std::to_string(i)] = 0x10 + i;
-			instructionMap[std::string("LDH ") + std::to_string(i)] = 0x20 + i;
+//the parallel engine against the sorted event engine on the same program, registers and memory have to match
+void testParallel() {
+	CPUTester reference;
+	for (int threads : { 0, 1, 2, 4 }) {
+		CPUTester local;
+		CPUTester& tester = threads == 0 ? reference : local;
+		tester.cpu.wordCount = 256;
+		tester.build();
+		tester.circuit.setGateDelay(GateType::D_LATCH, 3);
+		tester.circuit.setSimulationMode(true);
+		if (threads > 0) {
+			tester.circuit.setThreadCount(threads);
+			tester.circuit.setSimulationEngine(SimulationEngine::PARALLEL);
 		}
+		tester.loadProgram(testProgram, 0);
+
+		Clock clock;
+		tester.run(false, 500);
+		double time = clock.elapsed();
+		bool valid = tester.sameState(reference) && tester.circuit.getSimulationTime() == reference.circuit.getSimulationTime();
+		printf("%-9s %i threads, run %fs, %.3f kH, sim time %lli, result: %s\n",
+			threads == 0 ? "event:" : "parallel:", std::max(threads, 1), time, tester.clockCyclesTotal / time / 1000,
+			(long long)tester.circuit.getSimulationTime(), valid ? "OK" : "FAIL");
+	}
+}
 
-		instructionMap["LD"] = 0x30;
-		instructionMap["ST"] = 0x40;
+//runs many small programs on copies of one prepared cpu
+void testFarm() {
+	CPUTester design;
+	design.cpu.wordCount = 256;
+	design.build();
+	design.circuit.setGateDelay(GateType::D_LATCH, 3);
+	design.circuit.setSimulationMode(false);
+
+	int jobCount = 64;
+	std::vector<SimulationJob> jobs(jobCount);
+	for (int i = 0; i < jobCount; i++) {
+		std::string code = "LDL " + std::to_string(i % 16) + "\nLDH " + std::to_string(i / 16) + "\nMV ACC A\n";
+		code += "LDL " + std::to_string((i * 7) % 16) + "\nLDH 0\nADD A\nMV ACC B\nHALT\n";
+		std::vector<int> program = design.assemble(code);
+
+		auto& job = jobs[i];
+		job.outputs = { design.cpu.A.cell, design.cpu.B.cell };
+		job.stimulus = [&design, program](Circuit& circuit) {
+			auto& cpu = design.cpu;
+			cpu.pc.cell.rebind(&circuit).setValue(0);
+			for (int k = 0; k < program.size(); k++) {
+				cpu.memory.cells[k].rebind(&circuit).setValue(program[k]);
+			}
 
-		std::vector<std::string> registerNames = {
-			"PC", "INST", "FLAG", "ACC", "ADDRL", "ADDRH", "A", "B", "C", "D", "E", "F",
+			Pin clock = design.clock.rebind(&circuit);
+			Pin memoryClock = design.memoryClock.rebind(&circuit);
+			Bus inst = cpu.inst.cell.rebind(&circuit);
+			for (int k = 0; k < 64 && inst.getValue() != 0x1; k++) {
+				for (int cycle = 0; cycle < 2; cycle++) {
+					clock.setValue(0);
+					circuit.settle(design.maxTimeUnitsPerPhase);
+					clock.setValue(1);
+					circuit.settle(design.maxTimeUnitsPerPhase);
+					memoryClock.setValue(1);
+					circuit.settle(design.maxTimeUnitsPerPhase);
+					memoryClock.setValue(0);
+					circuit.settle(design.maxTimeUnitsPerPhase);
+				}
+				clock.setValue(0);
+				circuit.settle(design.maxTimeUnitsPerPhase);
+			}
 		};
-		for (int i = 0; i < registerNames.size(); i++) {
-			auto name = registerNames[i];
-			instructionMap[std::string("MV ACC ") + name] = 0x50 + i;
-			instructionMap[std::string("MV ") + name + " ACC"] = 0x60 + i;
-			instructionMap[std::string("ADD ") + name] = 0x70 + i;
-			instructionMap[std::string("SUB ") + name] = 0x80 + i;
-			instructionMap[std::string("AND ") + name] = 0x90 + i;
-			instructionMap[std::string("OR ") + name] = 0xa0 + i;
-			instructionMap[std::string("XOR ") + name] = 0xc0 + i;
-		}
-
-		instructionMap["NOT"] = 0xb3;
-		instructionMap["NOT ACC"] = 0xb3;
 	}
 
-	void sim() {
-		timeUnitsSpentTotal += circuit.simulate(timeUnitsPerClockCycle);
-		//printf("needed: %i\n", circuit.simulate(timeUnitsPerClockCycle));
-	}
-
-	void tick(bool print = false) {
-		clock.setValue(0);
-		sim();
-		
-		//fetch
-		clock.setValue(1);
-		sim();
-
-		memoryClock.setValue(1);
-		sim();
-
-		memoryClock.setValue(0);
-		sim();
-
-		clock.setValue(0);
-		sim();
-
-		//execute
-		clock.setValue(1);
-		sim();
-
-		memoryClock.setValue(1);
-		sim();
+	SimulationFarm farm;
+	farm.setThreadCount(std::thread::hardware_concurrency());
+	farm.run(design.circuit.getNetlist(), jobs);
 
-		if (print) {
-			printState();
+	bool valid = true;
+	for (int i = 0; i < jobCount; i++) {
+		int a = i % 16 + (i / 16) * 16;
+		int b = (a + (i * 7) % 16) & 0xff;
+		if (jobs[i].results[0] != a || jobs[i].results[1] != b) {
+			valid = false;
 		}
-
-		memoryClock.setValue(0);
-		sim();
-
-		clock.setValue(0);
-		sim();
-
-		instructionsTotal++;
-		clockCyclesTotal += 2;
 	}
-
-	void printBus(Bus& bus, const std::string& name) {
-		printf("%s:\t  %s (0x%02X)\n", name.c_str(), bus.getStrValue().c_str(), (int)bus.getValue());
+	for (int i = 0; i < 4; i++) {
+		auto& job = jobs[i];
+		printf("job %i: A=0x%02X B=0x%02X took %fs, %lli events, %.0f events/s, thread %i\n", i, (int)job.results[0], (int)job.results[1],
+			job.stats.time, (long long)job.stats.events, job.stats.eventsPerSecond, job.stats.thread);
 	}
+	auto& stats = farm.getStats();
+	printf("jobs: %i on %i threads\n", stats.jobCount, stats.threadCount);
+	printf("took %fs (%.1f jobs/s, %lli steals)\n", stats.time, stats.jobsPerSecond, (long long)stats.steals);
+	printf("result: %s\n", valid ? "OK" : "FAIL");
+}
 
-	void printState(int memoryCellCount = 8) {
-		printBus(cpu.memory.dataBus, "mem data bus");
-		printBus(cpu.memory.addressBus, "mem addr bus");
-		printBus(cpu.dataBus, "data bus");
-		printBus(cpu.addressBus, "addr bus");
-
-		printBus(cpu.instBus, "instruction bus");
-
+//resets the cpu to a saved state instead of building it again
+void testSnapshot() {
+	CPUTester tester;
+	tester.cpu.wordCount = 256;
+	tester.build();
+	tester.circuit.setGateDelay(GateType::D_LATCH, 3);
+	tester.circuit.setSimulationMode(false);
+	tester.loadProgram("LDL 5\nLDH 3\nMV ACC A\nLDL 9\nLDH 0\nADD A\nMV ACC B\nST\nHALT\n", 0);
 
-		for (int i = 0; i < cpu.registerCount; i++) {
-			auto& reg = *cpu.registerByIndex[i];
-			auto& cell = reg.cell;
-		
-			if (reg.name == "inst") {
-				printf("%s:\t  %s (0x%02X) %s\n", reg.name.c_str(), cell.getStrValue().c_str(), (int)cell.getValue(), instructionFromCode(cell.getValue()).c_str());
-			}
-			else if (reg.name == "acc" || reg.name == "pc") {
-				auto& buffer = reg.bufferCell;
-				printf("%s:\t  %s (0x%02X)\n", reg.name.c_str(), buffer.getStrValue().c_str(), (int)buffer.getValue());
-			}
-			else {
-				printf("%s:\t  %s (0x%02X)\n", reg.name.c_str(), cell.getStrValue().c_str(), (int)cell.getValue());
-			}
+	Clock clock;
+	Snapshot boot = tester.circuit.snapshot();
+	double snapshotTime = clock.round();
+
+	//the second snapshot is taken in the middle of a clock edge, with events still pending
+	auto start = [&]() {
+		tester.tick();
+		tester.clock.setValue(1);
+		tester.circuit.simulate(5);
+	};
+	auto finish = [&]() {
+		tester.circuit.simulate(tester.timeUnitsPerClockCycle);
+		tester.run(false, 64);
+	};
+	start();
+	Snapshot running = tester.circuit.snapshot();
+	finish();
+	uint64_t a = tester.cpu.A.cell.getValue();
+	uint64_t b = tester.cpu.B.cell.getValue();
+	int64_t time = tester.circuit.getSimulationTime();
+
+	bool valid = true;
+	for (auto* snapshot : { &boot, &running }) {
+		clock.reset();
+		tester.circuit.restore(*snapshot);
+		double restoreTime = clock.round();
+		printf("restore took %.1f us (%i pending events)\n", restoreTime * 1000 * 1000, (int)snapshot->events.size());
+
+		if (snapshot == &boot) {
+			start();
+		}
+		finish();
+		if (tester.cpu.A.cell.getValue() != a || tester.cpu.B.cell.getValue() != b || tester.circuit.getSimulationTime() != time) {
+			valid = false;
 		}
+	}
+	printf("snapshot took %.1f us\n", snapshotTime * 1000 * 1000);
+	printf("result: %s\n", valid ? "OK" : "FAIL");
+}
 
-		printBus(cpu.aluInA, "alu A");
-		printBus(cpu.aluInB, "alu B");
-		printBus(cpu.aluOut, "alu O");
+//runs the same program on the cpu as built and after the optimization passes
+void testOptimization() {
+	CPUTester plain;
+	CPUTester optimized;
+	optimized.optimize = true;
+
+	for (auto* tester : { &plain, &optimized }) {
+		tester->cpu.wordCount = 256;
+		tester->build();
+		tester->circuit.setGateDelay(GateType::D_LATCH, 3);
+		tester->circuit.setSimulationMode(false);
+		tester->loadProgram(testProgram, 0);
+		tester->run(false, 2000);
+	}
 
-		memoryCellCount = std::min(memoryCellCount, (int)cpu.memory.cells.size());
-		for (int i = 0; i < memoryCellCount; i++) {
-			printf("mem[0x%02X]:   %s (0x%02X)\n", i, cpu.memory.cells[i].getStrValue().c_str(), (int)cpu.memory.cells[i].getValue());
-		}
+	bool valid = plain.instructionsTotal == optimized.instructionsTotal && plain.sameState(optimized);
+
+	auto& stats = optimized.circuit.getOptimizationStats();
+	printf("gates: %i -> %i\n", stats.gatesBefore, stats.gatesAfter);
+	printf("pins:  %i -> %i\n", stats.pinsBefore, stats.pinsAfter);
+	printf("lines: %i -> %i\n", stats.linesBefore, stats.linesAfter);
+	printf("removed: %i constant, %i duplicates, %i dead, %i turned into inverters\n",
+		stats.constantGates, stats.duplicateGates, stats.deadGates, stats.invertedGates);
+	printf("took %fs in %i rounds\n", stats.time, stats.rounds);
+	printf("events per instruction: %lli -> %lli\n",
+		(long long)(plain.circuit.getQueuedEventCount() / plain.instructionsTotal),
+		(long long)(optimized.circuit.getQueuedEventCount() / optimized.instructionsTotal));
+	printf("result: %s\n", valid ? "OK" : "FAIL");
+}
 
-		printf("\n");
+//the optimized cpu on the timed event engine, every phase is stepped one time unit at a time
+//the registers have to be the same at every time unit and every phase has to settle at the same time unit
+void testOptimizationTiming() {
+	CPUTester plain;
+	CPUTester optimized;
+	optimized.optimize = true;
+	for (auto* tester : { &plain, &optimized }) {
+		tester->cpu.wordCount = 256;
+		tester->build();
+		tester->circuit.setGateDelay(GateType::D_LATCH, 3);
+		tester->circuit.setSimulationMode(true);
+		tester->loadProgram(testProgram, 0);
 	}
 
-	std::vector<std::string> strSplit(const std::string& string, const std::string& delimiter, bool includeEmpty = false) {
-		std::vector<std::string> parts;
-		std::string token;
-		int delimiterIndex = 0;
-		for (char c : string) {
-			if ((int)delimiter.size() == 0) {
-				parts.push_back({ c, 1 });
+	//the phases of CPUTester::tick, 0 is the clock and 1 the memory clock
+	const int phases[][2] = { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 }, { 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 }, { 0, 0 } };
+	int instructions = 300;
+	int differentPhases = 0;
+	int differentUnits = 0;
+	for (int i = 0; i < instructions; i++) {
+		for (auto& phase : phases) {
+			for (auto* tester : { &plain, &optimized }) {
+				(phase[0] == 0 ? tester->clock : tester->memoryClock).setValue(phase[1]);
 			}
-			else if (c == delimiter[delimiterIndex]) {
-				delimiterIndex++;
-				if (delimiterIndex == delimiter.size()) {
-					if (includeEmpty || (int)token.size() != 0) {
-						parts.push_back(token);
+			int units[2] = { 0, 0 };
+			for (int unit = 0; unit < plain.maxTimeUnitsPerPhase; unit++) {
+				bool settled = true;
+				int index = 0;
+				for (auto* tester : { &plain, &optimized }) {
+					if (!tester->circuit.isSettled()) {
+						tester->circuit.simulate(1);
+						units[index]++;
+						settled = false;
 					}
-					token.clear();
-					delimiterIndex = 0;
+					index++;
+				}
+				if (settled) {
+					break;
+				}
+				if (!plain.sameState(optimized)) {
+					differentUnits++;
 				}
 			}
-			else {
-				token += delimiter.substr(0, delimiterIndex);
-				token.push_back(c);
-				delimiterIndex = 0;
-			}
-		}
-		token += delimiter.substr(0, delimiterIndex);
-		if (includeEmpty || (int)token.size() != 0) {
-			parts.push_back(token);
+			differentPhases += units[0] != units[1];
 		}
-		return parts;
 	}
+	printf("timed: %i instructions, %i of %i phases settled at another time, %i time units with different registers, result: %s\n",
+		instructions, differentPhases, instructions * 9, differentUnits, differentPhases == 0 && differentUnits == 0 ? "OK" : "FAIL");
+}
 
-	std::string instructionFromCode(int code) {
-		for (auto& i : instructionMap) {
-			if (i.second == code) {
-				return i.first;
-			}
+//gate level memory against the memory block, the block also runs with the full 64 KiB address space
+void testRam() {
+	CPUTester cells;
+	CPUTester block;
+	CPUTester full;
+	block.cpu.useRam = true;
+	full.cpu.useRam = true;
+	full.cpu.wordCount = 1 << 16;
+
+	for (auto* tester : { &cells, &block, &full }) {
+		if (tester != &full) {
+			tester->cpu.wordCount = 256;
 		}
-		return "";
+		Clock clock;
+		tester->build();
+		double buildTime = clock.round();
+		tester->circuit.setGateDelay(GateType::D_LATCH, 3);
+		tester->circuit.setSimulationMode(false);
+		tester->loadProgram(testProgram, 0);
+		tester->run(false, 2000);
+		double time = clock.round();
+
+		bool valid = tester->sameState(cells);
+		printf("%-6s %6i words: gates %6i, build %fs, run %fs, %lli events per instruction, result: %s\n",
+			tester->cpu.useRam ? "block" : "cells", tester->cpu.memory.wordCount, tester->circuit.getGateCount(), buildTime, time,
+			(long long)(tester->circuit.getQueuedEventCount() / tester->instructionsTotal), valid ? "OK" : "FAIL");
 	}
+}
 
-	int codeFomrInstruction(const std::string& str) {
-		if (instructionMap.contains(str)) {
-			return instructionMap[str];
-		}
-		return 0x00;
+void testWordBlocks() {
+	//bit 0: adders, bit 1: registers, bit 2: decoders, bit 3: bus enables
+	std::vector<std::pair<const char*, int>> configs = {
+		{ "gates", 0 },
+		{ "adders", 1 },
+		{ "registers", 2 },
+		{ "decoders", 4 },
+		{ "enables", 8 },
+		{ "all", 15 },
+	};
+
+	CPUTester reference;
+	for (auto& config : configs) {
+		CPUTester local;
+		CPUTester& tester = config.second == 0 ? reference : local;
+		tester.cpu.useWordAdders = config.second & 1;
+		tester.cpu.useWordRegisters = config.second & 2;
+		tester.cpu.useWordDecoders = config.second & 4;
+		tester.cpu.useWordEnables = config.second & 8;
+
+		Clock clock;
+		tester.build();
+		tester.circuit.setGateDelay(GateType::D_LATCH, 3);
+		tester.circuit.setSimulationMode(false);
+		tester.loadProgram(testProgram, 0);
+		tester.run(false, 2000);
+		double time = clock.round();
+
+		bool valid = tester.sameState(reference);
+		printf("%-10s gates %6i, pins %6i, run %fs, %lli events per instruction, result: %s\n",
+			config.first, tester.circuit.getGateCount(), tester.circuit.getPinCount(), time,
+			(long long)(tester.circuit.getQueuedEventCount() / tester.instructionsTotal), valid ? "OK" : "FAIL");
 	}
+}
 
-	void loadProgram(const std::string& code, int memoryOffset) {
-		cpu.pc.cell.setValue(memoryOffset);
-		auto lines = strSplit(code, "\n", false);
-		for (auto& line : lines) {
-			int byte = codeFomrInstruction(line);
-			if (byte != 0 || line == "NOOP") {
-				if (cpu.memory.cells.size() > memoryOffset) {
-					cpu.memory.cells[memoryOffset++].setValue(byte);
-				}
+//the same run without recording, with a VCD file and with the binary format
+void testWaveform() {
+	std::string files[] = { "", "cpu.vcd", "cpu.icwf" };
+	double baseTime = 0;
+	std::vector<uint64_t> reference;
+	for (int mode = 0; mode < 3; mode++) {
+		CPUTester tester;
+		tester.build();
+		tester.circuit.setGateDelay(GateType::D_LATCH, 3);
+		tester.circuit.setSimulationMode(false);
+		tester.loadProgram(testProgram, 0);
+
+		WaveformWriter writer;
+		std::string file = mode == 0 ? "" : (std::filesystem::temp_directory_path() / files[mode]).string();
+		if (mode != 0) {
+			tester.cpu.addWaveforms(writer);
+			if (!writer.open(file, mode == 1 ? WaveformFormat::VCD : WaveformFormat::BINARY)) {
+				printf("could not open %s\n", file.c_str());
+				return;
 			}
+			tester.circuit.setWaveformWriter(&writer);
 		}
-	}
 
-	void run(bool print, int maxCycles = 1024) {
-		for (int i = 0; i < maxCycles; i++) {
-			tick(print);
-			if (cpu.inst.cell.getValue() == 0x1) {
-				//HALT
-				break;
-			}
+		Clock clock;
+		tester.run(false, 2000);
+		double time = clock.round();
+		writer.close();
+		double closeTime = clock.round();
+
+		std::vector<uint64_t> values = tester.getState();
+		if (mode == 0) {
+			baseTime = time;
+			reference = values;
+			printf("no recording: run %fs\n", time);
+			continue;
 		}
+		printf("%-12s run %fs (%+.1f%%), close %fs, %lli changes of %i bits, %lli bytes, %lli stalls, result: %s\n",
+			mode == 1 ? "vcd:" : "binary:", time, (time / baseTime - 1) * 100, closeTime, (long long)writer.getChangeCount(),
+			(int)writer.bitPins.size(), (long long)writer.getBytesWritten(), (long long)writer.getStallCount(), values == reference ? "OK" : "FAIL");
+		std::filesystem::remove(file);
 	}
+}
 
-	void printInfo() {
-		printf("memory: %i bit (%i byte)\n", cpu.memory.wordCount * cpu.memory.dataBusSize, (cpu.memory.wordCount * cpu.memory.dataBusSize) / 8);
-		printf("data bus: %i bit\n", cpu.dataBusSize);
-		printf("address bus: %i bit\n", cpu.addressBusSize);
-
-		printf("gates: %i\n", circuit.getGateCount());
-		printf("lines: %i\n", circuit.getLineCount());
-		printf("pins:  %i\n", circuit.getPinCount());
-
-		printf("transistors: %i\n", circuit.getGateCount() * 2);
-		printf("\n");
-	}
-};
-
-void testCPU() {
+//which parts of the cpu cause the events
+void testScopeActivity() {
 	CPUTester tester;
-	tester.cpu.wordCount = 256;
-
 	tester.build();
 	tester.circuit.setGateDelay(GateType::D_LATCH, 3);
 	tester.circuit.setSimulationMode(false);
+	tester.loadProgram(testProgram, 0);
+	tester.circuit.resetStats();
+	tester.run(false, 500);
+	tester.circuit.dumpScopeActivity();
+}
 
-	tester.printInfo();
+//settled phases follow the gate delays, a fixed budget cuts longer phases short and carries their events into the next phase
+void testSettle() {
+	std::vector<uint64_t> reference;
+	for (int delay : { 1, 3, 6 }) {
+		for (int settle = 1; settle >= 0; settle--) {
+			CPUTester tester;
+			tester.settle = settle;
+			tester.build();
+			tester.circuit.setGateDelay(GateType::D_LATCH, delay);
+			tester.circuit.setSimulationMode(false);
+			tester.loadProgram(testProgram, 0);
+			tester.run(false, 500);
+
+			std::vector<uint64_t> values = tester.getState();
+			if (reference.empty()) {
+				reference = values;
+			}
+			printf("latch delay %i, %-8s %6i time units, longest phase %3i, unsettled phases %i, result: %s\n",
+				delay, settle ? "settle:" : "fixed:", tester.timeUnitsSpentTotal, settle ? tester.maxPhaseTimeUnits : tester.timeUnitsPerClockCycle,
+				tester.unsettledPhases, values == reference ? "OK" : "FAIL");
+		}
+	}
 
-	Clock clock;
+	//a ring oscillator never settles
+	Circuit circuit;
+	Pin enable = Pin(&circuit).input();
+	Pin ring = enable.connector();
+	ring.NOT().NOT().NOT().AND(enable).connect(ring);
+	circuit.prepare();
+	enable.setValue(true);
+	int timeNeeded = circuit.settle(100);
+	printf("ring oscillator: settle returned %i at time %lli\n", timeNeeded, (long long)circuit.getSimulationTime());
+}
 
-	std::string code = R"(
-LDL 3
-LDH 6
-MV ACC A
-LDL 1
-LDH 1
-MV ACC B
-LDH 2
-LDL 0
-MV ACC ADDRL
-
-LDL 1
-LDH 0
-ADD ADDRL
-MV ACC ADDRL
-MV C ACC
-ADD A
-MV ACC C
-ST
-LDL 1
-LDH 0
-ADD ADDRL
-MV ACC ADDRL
-MV C ACC
-ADD B
-MV ACC C
-ST
-
-# jump
-LDL 13
-LDH 14
-ADD PC
-MV ACC PC
-HALT
-)";
-
-	tester.loadProgram(code, 0);
+//host driven clock phases against clocks generated by the engine
+void testClockSource() {
+	std::vector<uint64_t> reference;
+	for (int clocked = 0; clocked < 2; clocked++) {
+		CPUTester tester;
+		tester.build();
+		tester.circuit.setGateDelay(GateType::D_LATCH, 3);
+		tester.circuit.setSimulationMode(false);
+		tester.loadProgram(testProgram, 0);
+		tester.circuit.resetStats();
+
+		Clock clock;
+		if (clocked) {
+			tester.runClocked(2000, 40);
+		}
+		else {
+			tester.run(false, 2000);
+		}
+		double time = clock.round();
 
-	clock.reset();
-	tester.run(false, 2000);
-	tester.printState(64);
-	
-	float time = clock.elapsed();
-	printf("took %fs\n", time);
-	printf("time units spent: %i\n", tester.timeUnitsSpentTotal);
-	printf("sim time: %i\n", tester.circuit.getSimulationTime());
-	printf("clock cycles: %i\n", tester.clockCyclesTotal);
-	printf("instructions: %i\n", tester.instructionsTotal);
-	printf("speed: %.3f kH\n", (tester.clockCyclesTotal / time) / 1000);
-	printf("unit took: %.0f ns\n", (time / tester.timeUnitsSpentTotal) * 1000 * 1000 * 1000);
-	printf("units per instruction: %i\n", tester.timeUnitsSpentTotal / tester.instructionsTotal);
-	printf("sim time units per instruction: %i\n", tester.circuit.getSimulationTime() / tester.instructionsTotal);
+		std::vector<uint64_t> values = tester.getState();
+		if (reference.empty()) {
+			reference = values;
+		}
+		auto& stats = tester.circuit.getStats();
+		printf("%-8s %i instructions, run %fs, %lli simulate calls, %lli clock edges, %lli events, result: %s\n",
+			clocked ? "clocks:" : "host:", tester.instructionsTotal, time, (long long)stats.simulateCalls, (long long)stats.clockEdges,
+			(long long)stats.events, values == reference ? "OK" : "FAIL");
+	}
 }
 
 int main() {
-	testCPU();
+	printf("event driven engine\n");
+	testCPU(SimulationEngine::EVENT);
+	printf("\nlevelized engine\n");
+	testCPU(SimulationEngine::LEVELIZED);
+	printf("\nparallel engine (%i threads)\n", (int)std::thread::hardware_concurrency());
+	testCPU(SimulationEngine::PARALLEL);
+	testParallel();
+	printf("\nsimulation farm\n");
+	testFarm();
+	printf("\nsnapshot\n");
+	testSnapshot();
+	printf("\noptimization\n");
+	testOptimization();
+	testOptimizationTiming();
+	printf("\nmemory block\n");
+	testRam();
+	printf("\nword level blocks\n");
+	testWordBlocks();
+	printf("\nwaveform\n");
+	testWaveform();
+	printf("\nscope activity\n");
+	testScopeActivity();
+	printf("\nsettle\n");
+	testSettle();
+	printf("\nclock source\n");
+	testClockSource();
 	system("pause");
 	return 0;
 }
@@ -8,16 +8,10 @@
 #include "core/Bus.h"
 #include "cpu/MemoryBank.h"
 #include <iostream>
-
-class SubCircuit {
-public:
-	Circuit* circuit;
-	std::vector<Index> internalPins;
-	std::string name;
-
-	std::map<std::string, Bus> buses;
-	std::map<std::string, Pin> pins;
-};
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <vector>
 
 void testMemory() {
 	Circuit circuit;
@@ -39,6 +33,15 @@ void testMemory() {
 	circuit.prepare();
 
 	printf("prepare took %fs\n", clock.round());
+	auto& timings = circuit.getPrepareTimings();
+	printf("  groups:        %fs\n", timings.groups);
+	printf("  connections:   %fs\n", timings.connections);
+	printf("  initial state: %fs\n", timings.initialState);
+
+	//kept armed, dumped when the check fails
+	circuit.addProbe("address", memory.addressBus, 16);
+	circuit.addProbe("data", memory.dataBus, 32);
+	circuit.addProbe("clock", memory.clock, 8);
 
 	//info
 	printf("gates: %i\n", circuit.getGateCount());
@@ -99,6 +102,7 @@ void testMemory() {
 	}
 	else {
 		printf("result: FAIL\n");
+		circuit.dumpProbes();
 	}
 
 	printf("\n");
@@ -106,7 +110,304 @@ void testMemory() {
 	printf("total took %fs\n", totalClock.round());
 }
 
+//memory bank with 8 bit words, the fixture of the demos below
+void buildMemory(Circuit& circuit, MemoryBank& memory, int addressBits, int addressBusSize = 16) {
+	memory.circuit = &circuit;
+	memory.addressBusSize = addressBusSize;
+	memory.dataBusSize = 8;
+	memory.wordCount = 1 << addressBits;
+	memory.build();
+}
+
+//spreads the accesses over the whole memory
+int hashedAddress(MemoryBank& memory, int access) {
+	return (int)(((int64_t)access * 2654435761ull) & (memory.wordCount - 1));
+}
+
+//writes value(lane, access) to address(access) for every access, then reads all of them back, one memory clock per access
+//circuit can be another circuit running the netlist of the memory, returns false if a read or a stored word differs
+bool writeAndReadBack(Circuit& circuit, MemoryBank& memory, int accessCount, const std::function<int(int access)>& address,
+	const std::function<int(int lane, int access)>& value, int laneCount = 1) {
+	Bus addressBus = memory.addressBus.rebind(&circuit);
+	Bus dataBus = memory.dataBus.rebind(&circuit);
+	Pin write = memory.write.rebind(&circuit);
+	Pin read = memory.read.rebind(&circuit);
+	Pin memoryClock = memory.clock.rebind(&circuit);
+
+	std::map<int, std::vector<int>> expected;
+	bool valid = true;
+	for (int pass = 0; pass < 2; pass++) {
+		bool writing = pass == 0;
+		for (int i = 0; i < accessCount; i++) {
+			int word = address(i);
+			addressBus.setValue(word);
+			if (writing) {
+				auto& values = expected[word];
+				values.resize(laneCount);
+				for (int lane = 0; lane < laneCount; lane++) {
+					values[lane] = value(lane, i);
+				}
+			}
+			for (int lane = 0; lane < laneCount; lane++) {
+				if (!dataBus.setValue(writing ? expected[word][lane] : 0, lane)) {
+					valid = false;
+				}
+			}
+			write.setValue(writing);
+			read.setValue(!writing);
+
+			memoryClock.setValue(true);
+			circuit.simulate();
+			if (!writing) {
+				for (int lane = 0; lane < laneCount; lane++) {
+					if (dataBus.getValue(lane) != expected[word][lane]) {
+						valid = false;
+					}
+				}
+			}
+			memoryClock.setValue(false);
+			circuit.simulate();
+		}
+	}
+	//the stored words can only be read from the circuit of the memory itself
+	if (&circuit == memory.circuit && laneCount == 1) {
+		for (auto& [word, values] : expected) {
+			if (memory.getWord(word) != values[0]) {
+				valid = false;
+			}
+		}
+	}
+	return valid;
+}
+
+void benchDeduplication() {
+	for (int i = 0; i < 2; i++) {
+		bool deduplication = i == 1;
+
+		Circuit circuit;
+		MemoryBank memory;
+		buildMemory(circuit, memory, 8);
+		circuit.setEventDeduplication(deduplication);
+		circuit.prepare();
+
+		int64_t queuedStart = circuit.getQueuedEventCount();
+		int64_t skippedStart = circuit.getSkippedEventCount();
+		int64_t timeStart = circuit.getSimulationTime();
+		Clock clock;
+		bool valid = writeAndReadBack(circuit, memory, memory.wordCount, [](int access) {
+			return access;
+		}, [](int lane, int access) {
+			return (access * 37) & 0xff;
+		});
+
+		double time = clock.elapsed();
+		printf("deduplication %s:\n", deduplication ? "on" : "off");
+		printf("  events queued:    %lli\n", (long long)(circuit.getQueuedEventCount() - queuedStart));
+		printf("  events saved:     %lli\n", (long long)(circuit.getSkippedEventCount() - skippedStart));
+		printf("  time units:       %lli\n", (long long)(circuit.getSimulationTime() - timeStart));
+		printf("  took:             %fs\n", time);
+		printf("  result: %s\n", valid ? "OK" : "FAIL");
+	}
+}
+
+//every lane writes and reads back its own memory contents
+void testLanes() {
+	Circuit circuit;
+	MemoryBank memory;
+	buildMemory(circuit, memory, 8);
+	circuit.setSimulationEngine(SimulationEngine::LEVELIZED);
+	int laneCount = circuit.setLaneCount(64);
+	circuit.prepare();
+
+	Clock clock;
+	bool valid = laneCount == 64 && writeAndReadBack(circuit, memory, memory.wordCount, [](int access) {
+		return access;
+	}, [](int lane, int access) {
+		return (access * 37 + lane * 101 + (access >> 3) * lane) & 0xff;
+	}, laneCount);
+
+	double time = clock.elapsed();
+	printf("lanes: %i\n", laneCount);
+	printf("  result: %s\n", valid ? "OK" : "FAIL");
+	printf("  took:   %fs\n", time);
+	printf("  lane cycles per second: %f\n", 2.0 * memory.wordCount * laneCount / time);
+}
+
+//many circuits share one prepared netlist, each with its own memory contents
+void testSharedNetlist() {
+	Circuit design;
+	MemoryBank memory;
+	buildMemory(design, memory, 8);
+	design.prepare();
+
+	Clock clock;
+	int instanceCount = 64;
+	std::vector<Circuit> instances(instanceCount);
+	for (auto& instance : instances) {
+		instance.setNetlist(design.getNetlist());
+	}
+	printf("shared netlist:\n");
+	printf("  instances: %i\n", instanceCount);
+	printf("  setup took: %fs\n", clock.round());
+
+	bool valid = true;
+	for (int i = 0; i < instanceCount; i++) {
+		valid &= writeAndReadBack(instances[i], memory, 16, [](int access) {
+			return access;
+		}, [i](int lane, int access) {
+			return (access * 7 + i) & 0xff;
+		});
+	}
+	printf("  result: %s\n", valid ? "OK" : "FAIL");
+	printf("  sim took: %fs\n", clock.round());
+}
+
+//saves the prepared memory and starts a second circuit from the file
+void testNetlistFile() {
+	Clock clock;
+	Circuit circuit;
+	MemoryBank memory;
+	buildMemory(circuit, memory, 12);
+	circuit.prepare();
+	double buildTime = clock.round();
+
+	std::string file = (std::filesystem::temp_directory_path() / "memory.icsim").string();
+	bool saved = circuit.saveNetlist(file);
+	double saveTime = clock.round();
+
+	Circuit loaded;
+	bool valid = saved && loaded.loadNetlist(file);
+	double loadTime = clock.round();
+	Circuit unchecked;
+	valid &= unchecked.loadNetlist(file, false);
+	double uncheckedTime = clock.round();
+
+	//the pin indices of the memory bank are the same in the loaded netlist
+	valid &= writeAndReadBack(loaded, memory, 64, [](int access) {
+		return access * 61;
+	}, [](int lane, int access) {
+		return (access * 13) & 0xff;
+	});
+	std::filesystem::remove(file);
+
+	printf("netlist file:\n");
+	printf("  pins:                  %i\n", loaded.getPinCount());
+	printf("  build and prepare:     %fs\n", buildTime);
+	printf("  save:                  %fs\n", saveTime);
+	printf("  load:                  %fs\n", loadTime);
+	printf("  load without hash:     %fs\n", uncheckedTime);
+	printf("  result: %s\n", valid ? "OK" : "FAIL");
+}
+
+//gate level cells against the memory block, the block keeps the cost per access when the size grows
+void testRam() {
+	printf("memory block:\n");
+	for (int addressSize : { 8, 12, 16, 20 }) {
+		for (bool useRam : { false, true }) {
+			if (!useRam && addressSize > 12) {
+				continue;
+			}
+			Circuit circuit;
+			MemoryBank memory;
+			memory.useRam = useRam;
+
+			Clock clock;
+			buildMemory(circuit, memory, addressSize, addressSize);
+			circuit.prepare();
+			double setupTime = clock.round();
+
+			int accessCount = 1024;
+			int64_t eventStart = circuit.getQueuedEventCount();
+			bool valid = writeAndReadBack(circuit, memory, accessCount, [&](int access) {
+				return hashedAddress(memory, access);
+			}, [](int lane, int access) {
+				return (access * 37) & 0xff;
+			});
+			double time = clock.round();
+
+			printf("  %-5s %7i words: gates %7i, setup %fs, %.2f us and %lli events per access, result: %s\n",
+				useRam ? "block" : "cells", memory.wordCount, circuit.getGateCount(), setupTime, time / (2 * accessCount) * 1000 * 1000,
+				(long long)((circuit.getQueuedEventCount() - eventStart) / (2 * accessCount)), valid ? "OK" : "FAIL");
+		}
+	}
+}
+
+//every word expanded gate by gate against instances of one word module
+//only the stored lines shrink, gates, pins and prepare time are the same for both
+void testModules() {
+	printf("modules:\n");
+	for (int addressSize : { 8, 10 }) {
+		for (bool useModules : { false, true }) {
+			Circuit circuit;
+			MemoryBank memory;
+			memory.useModules = useModules;
+
+			Clock clock;
+			buildMemory(circuit, memory, addressSize, addressSize);
+			double buildTime = clock.round();
+			//lines held by the circuit definition, module lines are stored once
+			int64_t storedLines = circuit.getNetlist()->lines.size();
+			for (auto& module : circuit.getNetlist()->modules) {
+				storedLines += module.lines.size();
+			}
+			circuit.prepare();
+			double prepareTime = clock.round();
+
+			bool valid = writeAndReadBack(circuit, memory, 256, [&](int access) {
+				return hashedAddress(memory, access);
+			}, [&](int lane, int access) {
+				return hashedAddress(memory, access) & 0xff;
+			});
+
+			printf("  %-7s %6i words: gates %8i, lines %8i, stored lines %8lli, build %fs, prepare %fs, result: %s\n",
+				useModules ? "modules" : "gates", memory.wordCount, circuit.getGateCount(), circuit.getLineCount(),
+				(long long)storedLines, buildTime, prepareTime, valid ? "OK" : "FAIL");
+			for (auto& stats : circuit.getModuleStats()) {
+				printf("    module \"%s\": %lli instances, %i gates, %i pins, %lli lines per instance, %lli gates and %lli lines in total\n",
+					stats.name.c_str(), (long long)stats.instanceCount, stats.gates, stats.pins, (long long)stats.lines,
+					(long long)stats.totalGates, (long long)stats.totalLines);
+			}
+		}
+	}
+}
+
+//cost of armed probes on a memory bank, probes on the buses only record the transitions of those nets
+void testProbes() {
+	printf("probes (%s):\n", ICSIM_PROBES ? "compiled in" : "compiled out");
+	for (int probeCount : { 0, 3 }) {
+		Circuit circuit;
+		MemoryBank memory;
+		buildMemory(circuit, memory, 8, 8);
+		circuit.prepare();
+		if (probeCount > 0) {
+			circuit.addProbe("address", memory.addressBus, 64);
+			circuit.addProbe("data", memory.dataBus, 64);
+			circuit.addProbe("clock", memory.clock, 4);
+		}
+
+		Clock clock;
+		bool valid = writeAndReadBack(circuit, memory, 1024, [](int access) {
+			return (access * 3) & 0xff;
+		}, [](int lane, int access) {
+			return access & 0xff;
+		});
+		double time = clock.elapsed();
+
+		printf("  %i probes: %fs, result: %s\n", probeCount, time, valid ? "OK" : "FAIL");
+		if (probeCount > 0) {
+			circuit.getProbe(2).dump();
+		}
+	}
+}
+
 int main() {
 	testMemory();
+	benchDeduplication();
+	testLanes();
+	testSharedNetlist();
+	testNetlistFile();
+	testRam();
+	testModules();
+	testProbes();
 	return 0;
 }